@@ -0,0 +1,197 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Набор представительных программ для замера производительности.
+ * Число итераций каждой программы фиксировано, поэтому показатели
+ * сравнимы между коммитами: рост ms/iter - регрессия, падение - выигрыш.
+ *
+ * Показатели:
+ *  - лексер: токены в секунду по Lexer::Tokenize;
+ *  - разбор + исполнение: полное время RunMythonProgram;
+ *  - исполнение: инструкции исходного текста в секунду по однажды
+ *    разобранной программе (число инструкций - количество лексем
+ *    Newline в тексте).
+ */
+struct Workload {
+    string name;
+    string source;
+    // Итерации полного цикла разбор + исполнение
+    int parse_run_iterations;
+    // Итерации исполнения заранее разобранной программы
+    int run_iterations;
+};
+
+// Рекурсивные вызовы методов: нагрузка на кадры вызовов и возвраты
+Workload FibWorkload() {
+    return {"fibonacci"s, R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print f.calc(15)
+)"s, 50, 200};
+}
+
+// Сборка строки из кусочков: цепочки конкатенаций и str()
+Workload StringAssemblyWorkload() {
+    return {"string assembly"s, R"(
+line = ''
+for i in range(200):
+  line = line + 'field=' + str(i) + ';' + 'tag' + '-'
+print 'len done'
+)"s, 50, 200};
+}
+
+// Плотный граф объектов: создание экземпляров, поля, цепочки атрибутов
+Workload ObjectGraphWorkload() {
+    return {"object graph"s, R"(
+class Leaf:
+  def __init__(v):
+    self.value = v
+
+class Node:
+  def __init__(v):
+    self.left = Leaf(v)
+    self.right = Leaf(v + 1)
+
+  def sum():
+    return self.left.value + self.right.value
+
+total = 0
+for i in range(150):
+  n = Node(i)
+  total = total + n.sum() + n.left.value
+print total
+)"s, 50, 200};
+}
+
+// Плотные сравнения: поиск минимума и максимума по вычисляемому ряду
+Workload ComparisonWorkload() {
+    return {"comparison dense"s, R"(
+lo = 100000
+hi = 0 - 100000
+x = 7
+for i in range(400):
+  x = x * 31 + 17 - x / 3
+  if x > 100000 or x < 0 - 100000:
+    x = x / 100
+  if x < lo:
+    lo = x
+  if x > hi:
+    hi = x
+  if lo <= hi and not lo == hi:
+    x = x + 1
+print lo < hi
+)"s, 50, 200};
+}
+
+vector<Workload> Workloads() {
+    return {FibWorkload(), StringAssemblyWorkload(), ObjectGraphWorkload(),
+            ComparisonWorkload()};
+}
+
+using Clock = chrono::steady_clock;
+
+double ToMilliseconds(Clock::duration d) {
+    return chrono::duration<double, milli>(d).count();
+}
+
+void RunMythonProgram(istream& input, ostream& output) {
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+
+    runtime::BufferedContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+}
+
+// Число инструкций исходного текста - количество лексем Newline
+size_t CountSourceStatements(const string& source) {
+    size_t count = 0;
+    for(const auto& token : parse::Lexer::Tokenize(source))
+        if(token.Is<parse::token_type::Newline>())
+            ++count;
+    return count;
+}
+
+void BenchmarkLexer(const Workload& workload) {
+    const int iterations = workload.parse_run_iterations * 4;
+    size_t tokens = 0;
+    const auto start = Clock::now();
+    for(int i = 0; i < iterations; ++i)
+        tokens += parse::Lexer::Tokenize(workload.source).size();
+    const auto elapsed = Clock::now() - start;
+
+    const double ms = ToMilliseconds(elapsed);
+    cout << "  lexer:     " << setw(8) << fixed << setprecision(2) << ms << " ms, "
+         << setprecision(0) << static_cast<double>(tokens) / ms * 1000.0 << " tokens/sec\n";
+}
+
+void BenchmarkParseAndRun(const Workload& workload) {
+    const auto start = Clock::now();
+    for(int i = 0; i < workload.parse_run_iterations; ++i) {
+        istringstream input(workload.source);
+        ostringstream output;
+        RunMythonProgram(input, output);
+    }
+    const auto elapsed = Clock::now() - start;
+
+    const double ms = ToMilliseconds(elapsed);
+    cout << "  parse+run: " << setw(8) << fixed << setprecision(2) << ms << " ms, "
+         << setprecision(3) << ms / workload.parse_run_iterations << " ms/iter\n";
+}
+
+void BenchmarkRun(const Workload& workload) {
+    istringstream input(workload.source);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    const size_t statements = CountSourceStatements(workload.source);
+
+    const auto start = Clock::now();
+    for(int i = 0; i < workload.run_iterations; ++i) {
+        ostringstream output;
+        runtime::BufferedContext context{output};
+        runtime::Closure closure;
+        program->Execute(closure, context);
+    }
+    const auto elapsed = Clock::now() - start;
+
+    const double ms = ToMilliseconds(elapsed);
+    cout << "  run:       " << setw(8) << fixed << setprecision(2) << ms << " ms, "
+         << setprecision(3) << ms / workload.run_iterations << " ms/iter, " << setprecision(0)
+         << static_cast<double>(statements * workload.run_iterations) / ms * 1000.0
+         << " source statements/sec\n";
+}
+
+}  // namespace
+
+int main() {
+    try {
+        for(const auto& workload : Workloads()) {
+            cout << workload.name << ":\n";
+            BenchmarkLexer(workload);
+            BenchmarkParseAndRun(workload);
+            BenchmarkRun(workload);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include "interpreter.h"
+
+#include "lexer.h"
+#include "parse.h"
+
+#include <ostream>
+#include <sstream>
+
+using namespace std;
+
+namespace mython {
+
+Interpreter::Interpreter(shared_ptr<runtime::Executable> program)
+    : program_(std::move(program)) {
+}
+
+Interpreter Interpreter::Parse(istream& input) {
+    parse::Lexer lexer(input);
+    return Interpreter(ParseProgram(lexer));
+}
+
+Interpreter Interpreter::Parse(string_view source) {
+    parse::Lexer lexer(source);
+    return Interpreter(ParseProgram(lexer));
+}
+
+void Interpreter::Run(ostream& output) const {
+    runtime::BufferedContext context{output};
+    runtime::Closure closure;
+    Run(closure, context);
+}
+
+void Interpreter::Run(runtime::Closure& closure, runtime::Context& context) const {
+    program_->Execute(closure, context);
+}
+
+}  // namespace mython
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+
+namespace mython {
+
+/*
+ * Интерпретатор Mython: разбирает исходный текст один раз в неизменяемую
+ * разделяемую программу и исполняет её произвольное число раз, в том числе
+ * параллельно из нескольких потоков. Каждый запуск получает собственные
+ * Closure и Context, объекты программы создаются в куче исполняющего потока;
+ * разделяемое состояние (таблица имён, встроенные кеши узлов) защищено
+ * мьютексом либо обновляется атомарно.
+ *
+ * Экземпляры Interpreter дёшево копируются и разделяют одну программу -
+ * N потоков больше не требуют N процессов с N копиями разобранного дерева.
+ */
+class Interpreter {
+public:
+    // Разбирает программу из потока input
+    [[nodiscard]] static Interpreter Parse(std::istream& input);
+
+    // Разбирает программу из текста source
+    [[nodiscard]] static Interpreter Parse(std::string_view source);
+
+    // Исполняет программу с собственным замыканием; вывод буферизуется
+    // и пишется в output. Может вызываться одновременно из разных потоков
+    void Run(std::ostream& output) const;
+
+    // Исполняет программу с заданными замыканием и контекстом
+    void Run(runtime::Closure& closure, runtime::Context& context) const;
+
+private:
+    explicit Interpreter(std::shared_ptr<runtime::Executable> program);
+
+    std::shared_ptr<runtime::Executable> program_;
+};
+
+}  // namespace mython
@@ -1,148 +1,211 @@
-#pragma once
-
-#include <iosfwd>
-#include <optional>
-#include <sstream>
-#include <stdexcept>
-#include <string>
-#include <variant>
-
-namespace parse {
-
-namespace token_type {
-struct Number {  // Лексема «число»
-    int value;   // число
-};
-
-struct Id {             // Лексема «идентификатор»
-    std::string value;  // Имя идентификатора
-};
-
-struct Char {    // Лексема «символ»
-    char value;  // код символа
-};
-
-struct String {  // Лексема «строковая константа»
-    std::string value;
-};
-
-struct Class {};    // Лексема «class»
-struct Return {};   // Лексема «return»
-struct If {};       // Лексема «if»
-struct Else {};     // Лексема «else»
-struct Def {};      // Лексема «def»
-struct Newline {};  // Лексема «конец строки»
-struct Print {};    // Лексема «print»
-struct Indent {};  // Лексема «увеличение отступа», соответствует двум пробелам
-struct Dedent {};  // Лексема «уменьшение отступа»
-struct Eof {};     // Лексема «конец файла»
-struct And {};     // Лексема «and»
-struct Or {};      // Лексема «or»
-struct Not {};     // Лексема «not»
-struct Eq {};      // Лексема «==»
-struct NotEq {};   // Лексема «!=»
-struct LessOrEq {};     // Лексема «<=»
-struct GreaterOrEq {};  // Лексема «>=»
-struct None {};         // Лексема «None»
-struct True {};         // Лексема «True»
-struct False {};        // Лексема «False»
-}  // namespace token_type
-
-using TokenBase
-    = std::variant<token_type::Number, token_type::Id, token_type::Char, token_type::String,
-                   token_type::Class, token_type::Return, token_type::If, token_type::Else,
-                   token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
-                   token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
-                   token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-                   token_type::None, token_type::True, token_type::False, token_type::Eof>;
-
-struct Token : TokenBase {
-    using TokenBase::TokenBase;
-
-    template <typename T>
-    [[nodiscard]] bool Is() const {
-        return std::holds_alternative<T>(*this);
-    }
-
-    template <typename T>
-    [[nodiscard]] const T& As() const {
-        return std::get<T>(*this);
-    }
-
-    template <typename T>
-    [[nodiscard]] const T* TryAs() const {
-        return std::get_if<T>(this);
-    }
-};
-
-bool operator==(const Token& lhs, const Token& rhs);
-bool operator!=(const Token& lhs, const Token& rhs);
-
-std::ostream& operator<<(std::ostream& os, const Token& rhs);
-
-class LexerError : public std::runtime_error {
-public:
-    using std::runtime_error::runtime_error;
-};
-
-class Lexer {
-
-public:
-    explicit Lexer(std::istream& input);
-
-    // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
-    [[nodiscard]] const Token& CurrentToken() const;
-
-    // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
-    Token NextToken();
-
-    // Если текущий токен имеет тип T, метод возвращает ссылку на него.
-    // В противном случае метод выбрасывает исключение LexerError
-    template <typename T>
-    const T& Expect() const {
-        using namespace std::literals;
-        if(token_.Is<T>()) return token_.As<T>();
-        throw LexerError("Expect()"s);
-    }
-
-    // Метод проверяет, что текущий токен имеет тип T, а сам токен содержит значение value.
-    // В противном случае метод выбрасывает исключение LexerError
-    template <typename T, typename U>
-    void Expect(const U& value) const {
-        using namespace std::literals;
-        if(token_.Is<T>() && token_.As<T>().value == value) return;
-        throw LexerError("Expect(value)"s);
-    }
-
-    // Если следующий токен имеет тип T, метод возвращает ссылку на него.
-    // В противном случае метод выбрасывает исключение LexerError
-    template <typename T>
-    const T& ExpectNext() {
-        using namespace std::literals;
-        NextToken();
-        return Expect<T>();
-        throw LexerError("ExpectNext()"s);
-    }
-
-    // Метод проверяет, что следующий токен имеет тип T, а сам токен содержит значение value.
-    // В противном случае метод выбрасывает исключение LexerError
-    template <typename T, typename U>
-    void ExpectNext(const U& value) {
-        using namespace std::literals;
-        NextToken();
-        return Expect<T>(value);
-        throw LexerError("ExpectNext(value)"s);
-    }
-
-private:
-
-    struct Helper;
-    friend struct Helper;
-
-    std::istream& input_;
-    Token token_ = token_type::Eof{};
-    int indent_count_ = 0;
-    bool indent_equal_ = false;
-};
-
-}  // namespace parse
+#pragma once
+
+#include <iosfwd>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace parse {
+
+namespace token_type {
+struct Number {  // Лексема «число»
+    int value;   // число
+};
+
+struct Id {             // Лексема «идентификатор»
+    std::string value;  // Имя идентификатора
+};
+
+struct Char {    // Лексема «символ»
+    char value;  // код символа
+};
+
+struct String {  // Лексема «строковая константа»
+    std::string value;
+};
+
+struct Class {};    // Лексема «class»
+struct Return {};   // Лексема «return»
+struct If {};       // Лексема «if»
+struct Else {};     // Лексема «else»
+struct While {};    // Лексема «while»
+struct For {};      // Лексема «for»
+struct In {};       // Лексема «in»
+struct Def {};      // Лексема «def»
+struct Newline {};  // Лексема «конец строки»
+struct Print {};    // Лексема «print»
+struct Indent {};  // Лексема «увеличение отступа», соответствует двум пробелам
+struct Dedent {};  // Лексема «уменьшение отступа»
+struct Eof {};     // Лексема «конец файла»
+struct And {};     // Лексема «and»
+struct Or {};      // Лексема «or»
+struct Not {};     // Лексема «not»
+struct Eq {};      // Лексема «==»
+struct NotEq {};   // Лексема «!=»
+struct LessOrEq {};     // Лексема «<=»
+struct GreaterOrEq {};  // Лексема «>=»
+struct None {};         // Лексема «None»
+struct True {};         // Лексема «True»
+struct False {};        // Лексема «False»
+}  // namespace token_type
+
+using TokenBase
+    = std::variant<token_type::Number, token_type::Id, token_type::Char, token_type::String,
+                   token_type::Class, token_type::Return, token_type::If, token_type::Else,
+                   token_type::While, token_type::For, token_type::In, token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
+                   token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
+                   token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
+                   token_type::None, token_type::True, token_type::False, token_type::Eof>;
+
+struct Token : TokenBase {
+    using TokenBase::TokenBase;
+
+    template <typename T>
+    [[nodiscard]] bool Is() const {
+        return std::holds_alternative<T>(*this);
+    }
+
+    template <typename T>
+    [[nodiscard]] const T& As() const {
+        return std::get<T>(*this);
+    }
+
+    template <typename T>
+    [[nodiscard]] const T* TryAs() const {
+        return std::get_if<T>(this);
+    }
+};
+
+bool operator==(const Token& lhs, const Token& rhs);
+bool operator!=(const Token& lhs, const Token& rhs);
+
+std::ostream& operator<<(std::ostream& os, const Token& rhs);
+
+class LexerError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Файл, отображённый в память: даёт лексеру непрерывный буфер
+// без копирования содержимого и потокового ввода-вывода
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view GetView() const {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+class Lexer {
+
+public:
+    explicit Lexer(std::istream& input);
+
+    // Режим непрерывного буфера: символы читаются по индексу, без обращений
+    // к потоку и без putback. buffer должен жить не меньше лексера
+    explicit Lexer(std::string_view buffer);
+
+    // Режим заранее разобранных токенов: лексер лишь выдаёт их по индексу.
+    // Позволяет разобрать вход один раз и разбирать программу многократно,
+    // а также заглядывать вперёд на произвольное число токенов.
+    // tokens должен жить не меньше лексера
+    explicit Lexer(const std::vector<Token>& tokens);
+
+    // Разбирает весь buffer в плотный вектор токенов (без завершающего Eof)
+    static std::vector<Token> Tokenize(std::string_view buffer);
+
+    // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
+    [[nodiscard]] const Token& CurrentToken() const;
+
+    // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
+    Token NextToken();
+
+    // Возвращает токен, отстоящий от текущего на offset вперёд, либо
+    // token_type::Eof за концом входа. Работает только в режиме заранее
+    // разобранных токенов; offset, равный нулю, означает текущий токен
+    [[nodiscard]] const Token& LookAhead(std::size_t offset) const;
+
+    // Если текущий токен имеет тип T, метод возвращает ссылку на него.
+    // В противном случае метод выбрасывает исключение LexerError
+    template <typename T>
+    const T& Expect() const {
+        using namespace std::literals;
+        if(token_.Is<T>()) return token_.As<T>();
+        throw LexerError("Expect()"s);
+    }
+
+    // Метод проверяет, что текущий токен имеет тип T, а сам токен содержит значение value.
+    // В противном случае метод выбрасывает исключение LexerError
+    template <typename T, typename U>
+    void Expect(const U& value) const {
+        using namespace std::literals;
+        if(token_.Is<T>() && token_.As<T>().value == value) return;
+        throw LexerError("Expect(value)"s);
+    }
+
+    // Если следующий токен имеет тип T, метод возвращает ссылку на него.
+    // В противном случае метод выбрасывает исключение LexerError
+    template <typename T>
+    const T& ExpectNext() {
+        using namespace std::literals;
+        NextToken();
+        return Expect<T>();
+        throw LexerError("ExpectNext()"s);
+    }
+
+    // Метод проверяет, что следующий токен имеет тип T, а сам токен содержит значение value.
+    // В противном случае метод выбрасывает исключение LexerError
+    template <typename T, typename U>
+    void ExpectNext(const U& value) {
+        using namespace std::literals;
+        NextToken();
+        return Expect<T>(value);
+        throw LexerError("ExpectNext(value)"s);
+    }
+
+private:
+
+    struct Helper;
+    friend struct Helper;
+
+    // Возвращает очередной символ источника, не поглощая его, либо -1 в конце
+    [[nodiscard]] int Peek() const {
+        if(input_ != nullptr) return input_->peek();
+        return pos_ < buffer_.size() ? static_cast<unsigned char>(buffer_[pos_]) : -1;
+    }
+
+    // Поглощает и возвращает очередной символ источника либо -1 в конце
+    int Get() {
+        if(input_ != nullptr) return input_->get();
+        return pos_ < buffer_.size() ? static_cast<unsigned char>(buffer_[pos_++]) : -1;
+    }
+
+    // Возвращает последний поглощённый символ обратно в источник
+    void Putback(char c) {
+        if(input_ != nullptr) input_->putback(c);
+        else if(pos_ > 0) --pos_;
+    }
+
+    std::istream* input_ = nullptr;
+    std::string_view buffer_{};
+    std::size_t pos_ = 0;
+    const std::vector<Token>* tokens_ = nullptr;
+    std::size_t token_pos_ = 0;
+    Token token_ = token_type::Eof{};
+    int indent_count_ = 0;
+    bool indent_equal_ = false;
+};
+
+}  // namespace parse
@@ -1,140 +1,722 @@
-#include "lexer.h"
-#include "parse.h"
-#include "runtime.h"
-#include "statement.h"
-#include "test_runner.h"
-
-#include <iostream>
-
-using namespace std;
-
-namespace parse {
-void RunOpenLexerTests(TestRunner& tr);
-}  // namespace parse
-
-namespace ast {
-void RunUnitTests(TestRunner& tr);
-}
-namespace runtime {
-void RunObjectHolderTests(TestRunner& tr);
-void RunObjectsTests(TestRunner& tr);
-}  // namespace runtime
-
-void TestParseProgram(TestRunner& tr);
-
-namespace {
-
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
-
-    runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
-}
-
-void TestSimplePrints() {
-    istringstream input(R"(
-print 57
-print 10, 24, -8
-print 'hello'
-print "world"
-print True, False
-print
-print None
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
-}
-
-void TestAssignments() {
-    istringstream input(R"(
-x = 57
-print x
-x = 'C++ black belt'
-print x
-y = False
-x = y
-print x
-x = None
-print x, y
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
-}
-
-void TestArithmetics() {
-    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
-}
-
-void TestVariablesArePointers() {
-    istringstream input(R"(
-class Counter:
-  def __init__():
-    self.value = 0
-
-  def add():
-    self.value = self.value + 1
-
-class Dummy:
-  def do_add(counter):
-    counter.add()
-
-x = Counter()
-y = x
-
-x.add()
-y.add()
-
-print x.value
-
-d = Dummy()
-d.do_add(x)
-
-print y.value
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "2\n3\n");
-}
-
-void TestAll() {
-    TestRunner tr;
-    parse::RunOpenLexerTests(tr);
-    runtime::RunObjectHolderTests(tr);
-    runtime::RunObjectsTests(tr);
-    ast::RunUnitTests(tr);
-    TestParseProgram(tr);
-
-    RUN_TEST(tr, TestSimplePrints);
-    RUN_TEST(tr, TestAssignments);
-    RUN_TEST(tr, TestArithmetics);
-    RUN_TEST(tr, TestVariablesArePointers);
-}
-
-}  // namespace
-
-int main() {
-    try {
-        TestAll();
-
-        RunMythonProgram(cin, cout);
-    } catch (const std::exception& e) {
-        std::cerr << e.what() << std::endl;
-		return 1;
-    }
-    return 0;
-}
+#include "interpreter.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "statement.h"
+#include "test_runner.h"
+#include "vm.h"
+
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace parse {
+void RunOpenLexerTests(TestRunner& tr);
+}  // namespace parse
+
+namespace ast {
+void RunUnitTests(TestRunner& tr);
+}
+namespace runtime {
+void RunObjectHolderTests(TestRunner& tr);
+void RunObjectsTests(TestRunner& tr);
+}  // namespace runtime
+
+void TestParseProgram(TestRunner& tr);
+
+namespace {
+
+void RunMythonProgram(istream& input, ostream& output) {
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+
+    // Буферизованный контекст: print пишет крупными блоками, минуя iostream
+    runtime::BufferedContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+}
+
+// Компилирует программу в байткод и исполняет её виртуальной машиной
+void RunMythonProgramVM(istream& input, ostream& output) {
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    auto chunk = vm::Compiler{}.Compile(*program);
+
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    vm::VirtualMachine{}.Run(chunk, closure, context);
+}
+
+void TestSimplePrints() {
+    istringstream input(R"(
+print 57
+print 10, 24, -8
+print 'hello'
+print "world"
+print True, False
+print
+print None
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
+}
+
+void TestAssignments() {
+    istringstream input(R"(
+x = 57
+print x
+x = 'C++ black belt'
+print x
+y = False
+x = y
+print x
+x = None
+print x, y
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
+}
+
+void TestArithmetics() {
+    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
+}
+
+void TestVariablesArePointers() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+class Dummy:
+  def do_add(counter):
+    counter.add()
+
+x = Counter()
+y = x
+
+x.add()
+y.add()
+
+print x.value
+
+d = Dummy()
+d.do_add(x)
+
+print y.value
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "2\n3\n");
+}
+
+void TestVMArithmetics() {
+    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
+
+    ostringstream output;
+    RunMythonProgramVM(input, output);
+
+    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
+}
+
+void TestVMControlFlow() {
+    istringstream input(R"(
+x = 4
+if x > 2 and not x == 5:
+  print 'big', x
+else:
+  print 'small'
+y = x < 10 or x > 100
+print y
+)");
+
+    ostringstream output;
+    RunMythonProgramVM(input, output);
+
+    ASSERT_EQUAL(output.str(), "big 4\nTrue\n");
+}
+
+// Классы и вызовы методов исполняются через Op::Exec - фолбэк на обходчик дерева
+void TestVMClasses() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+x = Counter()
+x.add()
+x.add()
+print x.value
+)");
+
+    ostringstream output;
+    RunMythonProgramVM(input, output);
+
+    ASSERT_EQUAL(output.str(), "2\n");
+}
+
+// Цикл while исполняется итеративно: глубокая рекурсия не нужна,
+// return внутри тела завершает объемлющий метод
+void TestWhileLoop() {
+    istringstream input(R"(
+class Finder:
+  def first_square_above(limit):
+    i = 0
+    while i < 100:
+      if i * i > limit:
+        return i
+      i = i + 1
+    return 0
+
+i = 0
+total = 0
+while i < 5:
+  total = total + i
+  i = i + 1
+print total, i
+
+f = Finder()
+print f.first_square_above(50)
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "10 5\n8\n");
+}
+
+// Цикл for перебирает диапазон чисел; границы вычисляются один раз
+void TestForLoop() {
+    istringstream input(R"(
+class Acc:
+  def sum_to(n):
+    total = 0
+    for i in range(n):
+      total = total + i
+    return total
+
+for x in range(2, 5):
+  print x
+
+a = Acc()
+print a.sum_to(10)
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "2\n3\n4\n45\n");
+}
+
+// Конкатенация наращивает буфер временного операнда на месте; значение,
+// видимое из переменной, при этом не меняется
+void TestStringConcat() {
+    istringstream input(R"(
+line = 'a' + 'b' + 'c' + 'd' + 'e'
+print line
+
+base = 'xy'
+alias = base
+longer = base + 'z' + '!'
+print base, alias, longer
+print str(base), str(42), str(True), str(None)
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "abcde\nxy xy xyz!\nxy 42 True None\n");
+}
+
+// Кешированный доступ к цепочкам полей: повторные чтения a.b.c идут
+// по запомненному слоту, смена класса объекта сбрасывает кеш шага
+void TestAttributePathCache() {
+    istringstream input(R"(
+class Limits:
+  def __init__():
+    self.max_batch = 32
+
+class Ctx:
+  def __init__():
+    self.limits = Limits()
+
+class Wide:
+  def __init__(v):
+    self.x = v
+
+class Narrow:
+  def __init__(v):
+    self.x = v + 100
+
+ctx = Ctx()
+total = 0
+for i in range(3):
+  total = total + ctx.limits.max_batch
+print total
+
+total = 0
+for i in range(4):
+  if i < 2:
+    o = Wide(7)
+  else:
+    o = Narrow(7)
+  total = total + o.x
+print total
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "96\n228\n");
+}
+
+// Цикл while компилируется в байткод обратным переходом
+void TestVMWhileLoop() {
+    istringstream input(R"(
+i = 0
+total = 0
+while i < 5:
+  total = total + i
+  i = i + 1
+print total, i
+)");
+
+    ostringstream output;
+    RunMythonProgramVM(input, output);
+
+    ASSERT_EQUAL(output.str(), "10 5\n");
+}
+
+void TestConstantFolding() {
+    // Свёртка выражения: дерево 2 * (3 + 4) заменяется одной константой
+    auto expr = unique_ptr<ast::Statement>(make_unique<ast::Mult>(
+        make_unique<ast::NumericConst>(2),
+        make_unique<ast::Add>(make_unique<ast::NumericConst>(3),
+                              make_unique<ast::NumericConst>(4))));
+    ast::Optimize(expr);
+    auto folded = dynamic_cast<ast::NumericConst*>(expr.get());
+    ASSERT(folded != nullptr);
+    ASSERT_EQUAL(folded->Value().GetValue(), 14);
+
+    // Результат свёрнутой программы не отличается от исходной
+    istringstream input(R"(
+x = 2 + 2 * 2
+if 1 < 2:
+  print x, 'yes' + '!'
+else:
+  print 'unreachable'
+)");
+    ostringstream output;
+    RunMythonProgram(input, output);
+    ASSERT_EQUAL(output.str(), "6 yes!\n");
+}
+
+// Вывод экземпляра класса идёт через поток и должен сохранять порядок
+// относительно значений, накопленных в буфере контекста
+void TestBufferedOutput() {
+    istringstream input(R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+  def __str__():
+    return 'Point(' + str(self.x) + ')'
+
+p = Point(42)
+print 1, p, 'tail'
+print True, None
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "1 Point(42) tail\nTrue None\n");
+}
+
+// Сериализация байткода: сохранённый Chunk исполняется без разбора исходника
+void TestChunkSerialization() {
+    const string source = "x = 2\nprint x + 3, 'a' + 'b', x < 10"s;
+
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    auto chunk = vm::Compiler{}.Compile(*program);
+
+    const auto hash = vm::HashSource(source);
+    ostringstream saved;
+    ASSERT(vm::SaveChunk(chunk, hash, saved));
+
+    // Несовпадающий хеш означает устаревший файл - программа разбирается заново
+    istringstream stale(saved.str());
+    ASSERT(!vm::LoadChunk(stale, hash + 1).has_value());
+
+    istringstream fresh(saved.str());
+    auto loaded = vm::LoadChunk(fresh, hash);
+    ASSERT(loaded.has_value());
+
+    ostringstream output;
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    vm::VirtualMachine{}.Run(*loaded, closure, context);
+    ASSERT_EQUAL(output.str(), "5 ab True\n");
+
+    // Программа с классами исполняется через Op::Exec; узлы AST
+    // записываются вместе с байткодом, и загруженный Chunk владеет ими сам -
+    // исходное дерево к этому моменту уже разрушено
+    const string class_source = "class A:\n  def f():\n    return 7\na = A()\nprint a.f()"s;
+    const auto class_hash = vm::HashSource(class_source);
+    ostringstream class_saved;
+    {
+        istringstream class_input(class_source);
+        parse::Lexer class_lexer(class_input);
+        auto class_program = ParseProgram(class_lexer);
+        auto class_chunk = vm::Compiler{}.Compile(*class_program);
+        ASSERT(vm::SaveChunk(class_chunk, class_hash, class_saved));
+    }
+
+    istringstream class_fresh(class_saved.str());
+    auto class_loaded = vm::LoadChunk(class_fresh, class_hash);
+    ASSERT(class_loaded.has_value());
+
+    ostringstream class_output;
+    runtime::SimpleContext class_context{class_output};
+    runtime::Closure class_closure;
+    vm::VirtualMachine{}.Run(*class_loaded, class_closure, class_context);
+    ASSERT_EQUAL(class_output.str(), "7\n");
+}
+
+// Нативная реализация метода: вызывается напрямую, без кадра
+runtime::ObjectHolder NativeAbs(runtime::ClassInstance& /*self*/, runtime::ArgsView args,
+                                runtime::Context& /*context*/) {
+    const int value = args[0].TryAs<runtime::Number>()->GetValue();
+    return runtime::MakeNumber(value < 0 ? -value : value);
+}
+
+runtime::ObjectHolder NativeLen(runtime::ClassInstance& /*self*/, runtime::ArgsView args,
+                                runtime::Context& /*context*/) {
+    const auto& value = args[0].TryAs<runtime::String>()->GetValue();
+    return runtime::MakeNumber(static_cast<int>(value.size()));
+}
+
+// Класс с нативными методами регистрируется до разбора и доступен
+// программе наравне с объявленными классами
+void TestNativeMethods() {
+    vector<runtime::Method> methods;
+    methods.push_back({"abs"s, {"x"s}, nullptr, &NativeAbs});
+    methods.push_back({"len"s, {"s"s}, nullptr, &NativeLen});
+    const auto& cls = runtime::RegisterNativeClass(
+        runtime::Class("Util"s, std::move(methods), nullptr));
+    ASSERT_EQUAL(runtime::NativeClasses().back(), &cls);
+
+    istringstream input(R"(
+class Fancy(Util):
+  def twice_abs(x):
+    return self.abs(x) + self.abs(x)
+
+u = Util()
+print u.abs(0 - 5), u.abs(3), u.len('hello')
+
+f = Fancy()
+print f.twice_abs(0 - 4)
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "5 3 5\n8\n");
+}
+
+// Одна разобранная программа исполняется параллельно из нескольких потоков,
+// каждый поток со своим замыканием и своим выводом
+void TestInterpreterThreads() {
+    const string source = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(step):
+    self.value = self.value + step
+
+c = Counter()
+c.add(2)
+c.add(3)
+print c.value, 1 + 2, 'a' + 'b', c.value < 10
+)";
+
+    auto interpreter = mython::Interpreter::Parse(source);
+
+    constexpr int thread_count = 4;
+    vector<ostringstream> outputs(thread_count);
+    vector<thread> threads;
+    threads.reserve(thread_count);
+    for(int i = 0; i < thread_count; ++i)
+        threads.emplace_back([&interpreter, &out = outputs[i]] {
+            for(int run = 0; run < 100; ++run)
+                interpreter.Run(out);
+        });
+    for(auto& t : threads)
+        t.join();
+
+    for(const auto& out : outputs) {
+        string expected;
+        for(int run = 0; run < 100; ++run)
+            expected += "5 3 ab True\n";
+        ASSERT_EQUAL(out.str(), expected);
+    }
+}
+
+// Профилировщик: включённый контекст собирает счётчики вызовов
+// и суммарное время по методам
+void TestProfiler() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+c = Counter()
+for i in range(5):
+  c.add()
+print c.value
+)");
+
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+
+    ostringstream output;
+    runtime::ProfilingContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+    context.GetOutputStream();  // сбрасывает буфер вывода
+    ASSERT_EQUAL(output.str(), "5\n");
+
+    bool found_add = false;
+    bool found_init = false;
+    for(const auto& entry : context.GetProfiler()->Report()) {
+        if(entry.name == "Counter.add"s) {
+            found_add = true;
+            ASSERT_EQUAL(entry.calls, 5u);
+        } else if(entry.name == "Counter.__init__"s) {
+            found_init = true;
+            // Определение класса тоже создаёт экземпляр - плюс один вызов
+            ASSERT_EQUAL(entry.calls, 2u);
+        }
+    }
+    ASSERT(found_add);
+    ASSERT(found_init);
+
+    ostringstream dump;
+    context.GetProfiler()->Dump(dump);
+    ASSERT(dump.str().find("Counter.add"s) != string::npos);
+}
+
+// Потоковый режим: инструкции исполняются по мере разбора, определения
+// классов удерживаются возвращённым объектом, пока живы экземпляры
+void TestStreamingExecution() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+c = Counter()
+c.add()
+c.add()
+print c.value
+
+total = 0
+for i in range(4):
+  total = total + i
+print total
+)");
+
+    parse::Lexer lexer(input);
+    ostringstream output;
+    runtime::Closure closure;
+    unique_ptr<runtime::Executable> retained;
+    {
+        runtime::BufferedContext context{output};
+        retained = RunProgramStreaming(lexer, closure, context);
+    }
+
+    ASSERT_EQUAL(output.str(), "2\n6\n");
+    // Экземпляр в замыкании остаётся работоспособным: его класс жив
+    ASSERT(closure.at("c"s).TryAs<runtime::ClassInstance>() != nullptr);
+}
+
+// Циклы экземпляров недостижимы для подсчёта ссылок и освобождаются
+// только сборщиком циклов
+void TestCycleCollection() {
+    runtime::CollectCycles();  // остатки предыдущих тестов не влияют на счёт
+
+    istringstream input(R"(
+class Node:
+  def __init__():
+    self.next = None
+
+a = Node()
+b = Node()
+a.next = b
+b.next = a
+)");
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    // Замыкание программы умерло, но цикл a <-> b держит сам себя
+    ASSERT_EQUAL(runtime::CollectCycles(), 2u);
+    ASSERT_EQUAL(runtime::CollectCycles(), 0u);
+
+    // Достижимый экземпляр с циклом на себя не освобождается
+    runtime::Class cls("Loop"s, {}, nullptr);
+    auto holder = runtime::ObjectHolder::Own(runtime::ClassInstance(cls));
+    auto* instance = holder.TryAs<runtime::ClassInstance>();
+    instance->Fields()[runtime::Intern("me"s)] = holder;
+    ASSERT_EQUAL(runtime::CollectCycles(), 0u);
+
+    holder = runtime::ObjectHolder::None();
+    ASSERT_EQUAL(runtime::CollectCycles(), 1u);
+}
+
+// Счётчики памяти отражают живые объекты и пик, жёсткий предел
+// прерывает разогнавшуюся программу перехватываемой ошибкой
+void TestMemoryAccounting() {
+    runtime::CollectCycles();  // остатки предыдущих тестов не влияют на счёт
+    runtime::ResetPeakMemoryUsage();
+    const auto before = runtime::GetMemoryUsage();
+
+    {
+        istringstream input(R"(
+class Box:
+  def __init__(v):
+    self.value = v
+
+x = Box(1)
+y = Box(2)
+line = 'abcdefgh' + str(x.value)
+)");
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        program->Execute(closure, context);
+
+        const auto during = runtime::GetMemoryUsage();
+        ASSERT(during.ForType(runtime::Object::Type::ClassInstance).live_objects >=
+               before.ForType(runtime::Object::Type::ClassInstance).live_objects + 2);
+        ASSERT(during.ForType(runtime::Object::Type::String).live_bytes >
+               before.ForType(runtime::Object::Type::String).live_bytes);
+        ASSERT(during.total_live_bytes > before.total_live_bytes);
+    }
+
+    // Программа и замыкание разрушены - счётчики вернулись к исходным
+    const auto after = runtime::GetMemoryUsage();
+    ASSERT_EQUAL(after.total_live_bytes, before.total_live_bytes);
+    ASSERT_EQUAL(after.ForType(runtime::Object::Type::ClassInstance).live_objects,
+                 before.ForType(runtime::Object::Type::ClassInstance).live_objects);
+
+    // Пиковая отметка запомнила максимум и сбрасывается к текущему уровню
+    ASSERT(after.peak_live_bytes > after.total_live_bytes);
+    runtime::ResetPeakMemoryUsage();
+    ASSERT_EQUAL(runtime::GetMemoryUsage().peak_live_bytes, after.total_live_bytes);
+
+    runtime::SetMemoryLimit(after.total_live_bytes + 64);
+    try {
+        istringstream input(R"(
+line = 'x'
+while True:
+  line = line + '0123456789abcdef'
+)");
+        ostringstream output;
+        RunMythonProgram(input, output);
+        ASSERT(false);
+    } catch (const runtime_error&) {
+        // Предел превышен, процесс продолжает работу
+    }
+    runtime::SetMemoryLimit(0);
+    ASSERT_EQUAL(runtime::GetMemoryUsage().total_live_bytes, after.total_live_bytes);
+}
+
+// return вне метода отвергается парсером и не отравляет
+// последующие запуски в том же потоке
+void TestTopLevelReturn() {
+    istringstream input("print 1\nreturn 5\nprint 2\n");
+    ostringstream output;
+    try {
+        RunMythonProgram(input, output);
+        ASSERT(false);
+    } catch (const ParseError&) {
+    }
+
+    istringstream next("print 1\nprint 2\nprint 3\n");
+    ostringstream next_output;
+    RunMythonProgram(next, next_output);
+    ASSERT_EQUAL(next_output.str(), "1\n2\n3\n");
+}
+
+void TestAll() {
+    TestRunner tr;
+    parse::RunOpenLexerTests(tr);
+    runtime::RunObjectHolderTests(tr);
+    runtime::RunObjectsTests(tr);
+    ast::RunUnitTests(tr);
+    TestParseProgram(tr);
+
+    RUN_TEST(tr, TestSimplePrints);
+    RUN_TEST(tr, TestAssignments);
+    RUN_TEST(tr, TestArithmetics);
+    RUN_TEST(tr, TestVariablesArePointers);
+    RUN_TEST(tr, TestVMArithmetics);
+    RUN_TEST(tr, TestVMControlFlow);
+    RUN_TEST(tr, TestVMClasses);
+    RUN_TEST(tr, TestWhileLoop);
+    RUN_TEST(tr, TestForLoop);
+    RUN_TEST(tr, TestAttributePathCache);
+    RUN_TEST(tr, TestStringConcat);
+    RUN_TEST(tr, TestVMWhileLoop);
+    RUN_TEST(tr, TestConstantFolding);
+    RUN_TEST(tr, TestBufferedOutput);
+    RUN_TEST(tr, TestChunkSerialization);
+    RUN_TEST(tr, TestNativeMethods);
+    RUN_TEST(tr, TestInterpreterThreads);
+    RUN_TEST(tr, TestStreamingExecution);
+    RUN_TEST(tr, TestProfiler);
+    RUN_TEST(tr, TestCycleCollection);
+    RUN_TEST(tr, TestMemoryAccounting);
+    RUN_TEST(tr, TestTopLevelReturn);
+}
+
+}  // namespace
+
+// Тестовый двоичный файл: исполнение скриптов - в производственном mython
+int main() {
+    try {
+        TestAll();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+		return 1;
+    }
+    return 0;
+}
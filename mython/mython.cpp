@@ -0,0 +1,51 @@
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// Разбирает и исполняет программу, загруженную в лексер
+void Run(parse::Lexer& lexer, ostream& output) {
+    auto program = ParseProgram(lexer);
+
+    // Буферизованный контекст: print пишет крупными блоками, минуя iostream
+    runtime::BufferedContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+}
+
+}  // namespace
+
+/*
+ * Производственная точка входа: исполняет скрипт из файла-аргумента либо
+ * из stdin и ничего больше. Тестовый набор живёт в отдельном двоичном
+ * файле mython_tests - интерпретатор форкается на каждое пакетное
+ * задание, и прогон тестов при старте был бы чистой задержкой запуска.
+ * Файл скрипта отображается в память целиком (см. MappedFile), лексер
+ * читает его без копирования
+ */
+int main(int argc, char* argv[]) {
+    if(argc > 2) {
+        cerr << "Usage: "s << argv[0] << " [script.my]"s << endl;
+        return 1;
+    }
+
+    try {
+        if(argc == 2) {
+            parse::MappedFile file(argv[1]);
+            parse::Lexer lexer(file.GetView());
+            Run(lexer, cout);
+        } else {
+            parse::Lexer lexer(cin);
+            Run(lexer, cout);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
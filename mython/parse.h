@@ -1,18 +1,32 @@
-#pragma once
-
-#include <memory>
-#include <stdexcept>
-
-namespace parse {
-class Lexer;
-}
-
-namespace runtime {
-class Executable;
-}
-
-struct ParseError : std::runtime_error {
-    using std::runtime_error::runtime_error;
-};
-
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+
+namespace parse {
+class Lexer;
+}
+
+namespace runtime {
+class Closure;
+class Context;
+class Executable;
+}
+
+struct ParseError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+
+/*
+ * Потоковый разбор с исполнением: каждая верхнеуровневая инструкция
+ * выполняется, как только разобрана, и сразу освобождается - в памяти
+ * одновременно находится не всё дерево, а самая крупная инструкция.
+ * Определения классов (вместе с телами методов) удерживаются и возвращаются
+ * вызывающему: возвращённый объект должен жить, пока живы созданные
+ * программой объекты
+ */
+std::unique_ptr<runtime::Executable> RunProgramStreaming(parse::Lexer& lexer,
+                                                         runtime::Closure& closure,
+                                                         runtime::Context& context);
@@ -1,243 +1,1000 @@
-#include "runtime.h"
-
-#include <cassert>
-#include <optional>
-#include <sstream>
-#include <algorithm>
-
-using namespace std;
-
-namespace runtime {
-
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-    : data_(std::move(data)) {
-}
-
-void ObjectHolder::AssertIsValid() const {
-    assert(data_ != nullptr);
-}
-
-ObjectHolder ObjectHolder::Share(Object& object) {
-    // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
-}
-
-ObjectHolder ObjectHolder::None() {
-    return ObjectHolder();
-}
-
-Object& ObjectHolder::operator*() const {
-    AssertIsValid();
-    return *Get();
-}
-
-Object* ObjectHolder::operator->() const {
-    AssertIsValid();
-    return Get();
-}
-
-Object* ObjectHolder::Get() const {
-    return data_.get();
-}
-
-ObjectHolder::operator bool() const {
-    return Get() != nullptr;
-}
-
-bool IsTrue(const ObjectHolder& object) {
-    if(auto obj = object.TryAs<Bool>(); obj != nullptr)
-        return obj->GetValue();
-    if(auto obj = object.TryAs<Number>(); obj != nullptr)
-        return obj->GetValue() != 0;
-    if(auto obj = object.TryAs<String>(); obj != nullptr)
-        return obj->GetValue() != ""s;
-    return false;
-}
-
-void ClassInstance::Print(std::ostream& os, Context& context) {
-    if(HasMethod("__str__"s, 0)) {
-        auto result = Call("__str__"s, {}, context);
-        if(result.Get() != nullptr)
-            result.Get()->Print(os, context);
-        else
-            os << "None"s;
-    } else {
-        os << this;
-    }
-}
-
-bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
-    auto result = cls_.GetMethod(method);
-    if(result != nullptr && result->formal_params.size() == argument_count)
-        return true;
-    return false;
-}
-
-Closure& ClassInstance::Fields() {
-    return closure_;
-}
-
-const Closure& ClassInstance::Fields() const {
-    return closure_;
-}
-
-ClassInstance::ClassInstance(const Class& cls) : cls_(cls) {}
-
-ObjectHolder ClassInstance::Call(const std::string& method,
-                                 const std::vector<ObjectHolder>& actual_args,
-                                 Context& context) {
-    if(!HasMethod(method, actual_args.size()))
-        throw std::runtime_error("Not implemented"s);
-
-    auto method_ = cls_.GetMethod(method);
-
-    Closure closure{{"self"s, ObjectHolder::Share(*this)}};
-
-    for(size_t i = 0; i < actual_args.size(); ++i)
-        closure.insert({method_->formal_params[i], actual_args[i]});
-
-    return method_->body->Execute(closure, context);
-}
-
-Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-    : name_(name), methods_(std::move(methods)), parent_(parent) {}
-
-const Method* Class::GetMethod(const std::string& name) const {
-    for(auto& method : methods_)
-        if(name == method.name) return &method;
-
-    if(parent_ != nullptr)
-        return parent_->GetMethod(name);
-
-    return nullptr;
-}
-
-[[nodiscard]] const std::string& Class::GetName() const {
-    return name_;
-}
-
-void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
-    os << "Class "s << name_;
-}
-
-void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
-    os << (GetValue() ? "True"sv : "False"sv);
-}
-
-bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-
-    if(!lhs.operator bool()) {
-        if(!rhs.operator bool()) return true;
-        else throw std::runtime_error("Cannot compare objects for equality"s);
-    }
-
-    {
-        auto lhs_ = lhs.TryAs<Bool>();
-        auto rhs_ = rhs.TryAs<Bool>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() == rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for equality"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<Number>();
-        auto rhs_ = rhs.TryAs<Number>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() == rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for equality"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<String>();
-        auto rhs_ = rhs.TryAs<String>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() == rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for equality"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<ClassInstance>();
-        if(lhs_ != nullptr) {
-            if(lhs_->HasMethod("__eq__"s, 1)) {
-                auto result = lhs_->Call("__eq__"s, {rhs}, context);
-                return result.TryAs<Bool>()->GetValue();
-            } else
-                throw std::runtime_error("Cannot compare objects for equality"s);
-        }
-    }
-
-    throw std::runtime_error("Cannot compare objects for equality"s);
-}
-
-bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-
-    if(!lhs.operator bool())
-        throw std::runtime_error("Cannot compare objects for less"s);
-
-    {
-        auto lhs_ = lhs.TryAs<Bool>();
-        auto rhs_ = rhs.TryAs<Bool>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() < rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for less"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<Number>();
-        auto rhs_ = rhs.TryAs<Number>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() < rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for less"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<String>();
-        auto rhs_ = rhs.TryAs<String>();
-        if(lhs_ != nullptr) {
-            if(rhs_ != nullptr)
-                return lhs_->GetValue() < rhs_->GetValue();
-            else
-                throw std::runtime_error("Cannot compare objects for less"s);
-        }
-    }
-    {
-        auto lhs_ = lhs.TryAs<ClassInstance>();
-        if(lhs_ != nullptr) {
-            if(lhs_->HasMethod("__lt__"s, 1)) {
-                auto result = lhs_->Call("__lt__"s, {rhs}, context);
-                return result.TryAs<Bool>()->GetValue();
-            } else
-                throw std::runtime_error("Cannot compare objects for equality"s);
-        }
-    }
-
-    throw std::runtime_error("Cannot compare objects for less"s);
-}
-
-bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Equal(lhs, rhs, context);
-}
-
-bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Less(lhs, rhs, context) && !Equal(lhs, rhs, context);
-}
-
-bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Greater(lhs, rhs, context);
-}
-
-bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Less(lhs, rhs, context);
-}
-
-}  // namespace runtime
+#include "runtime.h"
+
+#include <cassert>
+#include <charconv>
+#include <iomanip>
+#include <mutex>
+#include <deque>
+#include <optional>
+#include <sstream>
+#include <unordered_set>
+#include <algorithm>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+struct SymbolTable {
+    // Таблица разделяется всеми интерпретаторами процесса и защищена
+    // мьютексом: интернирование встречается в основном при разборе
+    std::mutex guard;
+    std::unordered_map<std::string, Symbol> ids;
+    // deque: ссылки на строки остаются действительными при росте таблицы
+    std::deque<std::string> names;
+};
+
+SymbolTable& GetSymbolTable() {
+    static SymbolTable table;
+    return table;
+}
+
+// Активная арена потока; устанавливается через Arena::Scope
+thread_local Arena* current_arena = nullptr;
+
+// Реестр живых экземпляров классов текущего потока - обходится
+// сборщиком циклов CollectCycles
+std::unordered_set<ClassInstance*>& GetInstanceRegistry() {
+    thread_local std::unordered_set<ClassInstance*> registry;
+    return registry;
+}
+
+// Заголовок перед каждым узлом AST: помнит, выделена ли память из арены.
+// Размер кратен максимальному выравниванию, чтобы не сместить сам узел
+struct NodeHeader {
+    bool from_arena;
+};
+
+constexpr size_t kNodeHeaderSize = alignof(max_align_t);
+
+/*
+ * Пул кадров вызова: хеш-таблицы Closure переиспользуются между вызовами
+ * методов, поэтому кадр не выделяет и не разрушает память корзин при каждом
+ * вызове - повторно используемая таблица сохраняет свою ёмкость
+ */
+class FramePool {
+public:
+    Closure* Acquire() {
+        if(free_.empty())
+            return &frames_.emplace_back();
+
+        auto* frame = free_.back();
+        free_.pop_back();
+        return frame;
+    }
+
+    void Release(Closure* frame) {
+        frame->clear();
+        free_.push_back(frame);
+    }
+
+private:
+    // deque: адреса кадров остаются действительными при росте пула
+    std::deque<Closure> frames_;
+    std::vector<Closure*> free_;
+};
+
+FramePool& GetFramePool() {
+    thread_local FramePool pool;
+    return pool;
+}
+
+// Счётчики памяти и предел текущего потока (см. GetMemoryUsage)
+struct MemoryAccounting {
+    MemoryUsage usage;
+    // Предел суммарного объёма в байтах; 0 - предел не установлен
+    std::uint64_t limit = 0;
+};
+
+MemoryAccounting& GetMemoryAccounting() {
+    thread_local MemoryAccounting accounting;
+    return accounting;
+}
+
+// Объём объекта в байтах: сам объект плюс строковый буфер. Симметричность
+// занесения и списания строки обеспечивает ConcatStrings, корректирующая
+// счётчики при росте буфера на месте
+std::uint64_t ObjectFootprint(const Object& object) {
+    switch (object.GetType()) {
+    case Object::Type::Number:
+        return sizeof(Number);
+    case Object::Type::String:
+        return sizeof(String) + static_cast<const String&>(object).GetValue().capacity();
+    case Object::Type::Bool:
+        return sizeof(Bool);
+    case Object::Type::Class:
+        return sizeof(Class);
+    case Object::Type::ClassInstance:
+        return sizeof(ClassInstance);
+    default:
+        return sizeof(Object);
+    }
+}
+
+// Заносит создаваемый объект в счётчики потока. При превышении предела
+// объект освобождается, а наружу выбрасывается runtime_error
+void ChargeObject(Object& object) {
+    auto& accounting = GetMemoryAccounting();
+    const std::uint64_t bytes = ObjectFootprint(object);
+    if(accounting.limit != 0 && accounting.usage.total_live_bytes + bytes > accounting.limit) {
+        delete &object;
+        throw std::runtime_error("Memory limit exceeded"s);
+    }
+
+    auto& type_usage = accounting.usage.by_type[static_cast<std::size_t>(object.GetType())];
+    ++type_usage.live_objects;
+    type_usage.live_bytes += bytes;
+    accounting.usage.total_live_bytes += bytes;
+    if(accounting.usage.total_live_bytes > accounting.usage.peak_live_bytes)
+        accounting.usage.peak_live_bytes = accounting.usage.total_live_bytes;
+}
+
+// Списывает объект со счётчиков потока перед освобождением
+void UnchargeObject(const Object& object) {
+    auto& accounting = GetMemoryAccounting();
+    const std::uint64_t bytes = ObjectFootprint(object);
+    auto& type_usage = accounting.usage.by_type[static_cast<std::size_t>(object.GetType())];
+    --type_usage.live_objects;
+    type_usage.live_bytes -= bytes;
+    accounting.usage.total_live_bytes -= bytes;
+}
+
+// Учитывает рост строкового буфера при конкатенации на месте.
+// Память уже выделена, поэтому счётчики обновляются до проверки предела
+void ChargeStringGrowth(std::uint64_t bytes) {
+    auto& accounting = GetMemoryAccounting();
+    auto& strings = accounting.usage.by_type[static_cast<std::size_t>(Object::Type::String)];
+    strings.live_bytes += bytes;
+    accounting.usage.total_live_bytes += bytes;
+    if(accounting.usage.total_live_bytes > accounting.usage.peak_live_bytes)
+        accounting.usage.peak_live_bytes = accounting.usage.total_live_bytes;
+    if(accounting.limit != 0 && accounting.usage.total_live_bytes > accounting.limit)
+        throw std::runtime_error("Memory limit exceeded"s);
+}
+
+// Владеет кадром из пула на время вызова метода
+class Frame {
+public:
+    Frame()
+        : closure_(GetFramePool().Acquire()) {
+    }
+    ~Frame() {
+        GetFramePool().Release(closure_);
+    }
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    Closure& Get() {
+        return *closure_;
+    }
+
+private:
+    Closure* closure_;
+};
+
+}  // namespace
+
+void* Arena::Allocate(std::size_t size, std::size_t align) {
+    const size_t aligned = (used_ + align - 1) / align * align;
+    if(blocks_.empty() || aligned + size > kBlockSize || size > kBlockSize) {
+        blocks_.push_back(std::make_unique<unsigned char[]>(std::max(size, kBlockSize)));
+        used_ = size;
+        return blocks_.back().get();
+    }
+    used_ = aligned + size;
+    return blocks_.back().get() + aligned;
+}
+
+Arena::Scope::Scope(Arena& arena)
+    : previous_(current_arena) {
+    current_arena = &arena;
+}
+
+Arena::Scope::~Scope() {
+    current_arena = previous_;
+}
+
+Arena* Arena::Current() {
+    return current_arena;
+}
+
+void* Executable::operator new(std::size_t size) {
+    auto* arena = Arena::Current();
+    void* raw = arena != nullptr ? arena->Allocate(kNodeHeaderSize + size, alignof(max_align_t))
+                                 : ::operator new(kNodeHeaderSize + size);
+    static_cast<NodeHeader*>(raw)->from_arena = arena != nullptr;
+    return static_cast<unsigned char*>(raw) + kNodeHeaderSize;
+}
+
+void Executable::operator delete(void* ptr) noexcept {
+    if(ptr == nullptr)
+        return;
+
+    auto* raw = static_cast<unsigned char*>(ptr) - kNodeHeaderSize;
+    if(!reinterpret_cast<NodeHeader*>(raw)->from_arena)
+        ::operator delete(raw);
+}
+
+Symbol Intern(const std::string& name) {
+    auto& table = GetSymbolTable();
+    std::lock_guard lock(table.guard);
+    if(auto it = table.ids.find(name); it != table.ids.end())
+        return it->second;
+
+    const auto symbol = static_cast<Symbol>(table.names.size());
+    table.names.push_back(name);
+    table.ids.emplace(name, symbol);
+    return symbol;
+}
+
+const std::string& SymbolName(Symbol symbol) {
+    auto& table = GetSymbolTable();
+    std::lock_guard lock(table.guard);
+    // Ссылка действительна и после разблокировки: deque не перемещает строки
+    return table.names.at(symbol);
+}
+
+ObjectHolder::ObjectHolder(Object* owned)
+    : object_(owned) {
+    if(object_ != nullptr) {
+        ChargeObject(*object_);
+        kind_ = Kind::Shared;
+        object_->AddRef();
+    }
+}
+
+ObjectHolder::ObjectHolder(const ObjectHolder& other) {
+    CopyFrom(other);
+}
+
+ObjectHolder::ObjectHolder(ObjectHolder&& other) noexcept {
+    if(other.kind_ == Kind::Shared) {
+        // Владение переходит без обращения к счётчику ссылок
+        object_ = other.object_;
+        kind_ = Kind::Shared;
+        other.object_ = nullptr;
+        other.kind_ = Kind::Empty;
+    } else {
+        // Встроенные значения дёшево копируются, перемещать нечего
+        CopyFrom(other);
+        other.Reset();
+    }
+}
+
+ObjectHolder& ObjectHolder::operator=(const ObjectHolder& other) {
+    if(this != &other) {
+        Reset();
+        CopyFrom(other);
+    }
+    return *this;
+}
+
+ObjectHolder& ObjectHolder::operator=(ObjectHolder&& other) noexcept {
+    if(this != &other) {
+        Reset();
+        if(other.kind_ == Kind::Shared) {
+            object_ = other.object_;
+            kind_ = Kind::Shared;
+            other.object_ = nullptr;
+            other.kind_ = Kind::Empty;
+        } else {
+            CopyFrom(other);
+            other.Reset();
+        }
+    }
+    return *this;
+}
+
+ObjectHolder::~ObjectHolder() {
+    Reset();
+}
+
+void ObjectHolder::Reset() {
+    switch (kind_) {
+    case Kind::Shared:
+        if(object_->ReleaseRef()) {
+            UnchargeObject(*object_);
+            delete object_;
+        }
+        break;
+    case Kind::Number:
+        static_cast<Number*>(object_)->~Number();
+        break;
+    case Kind::Bool:
+        static_cast<Bool*>(object_)->~Bool();
+        break;
+    case Kind::Borrowed:
+    case Kind::Empty:
+        break;
+    }
+    object_ = nullptr;
+    kind_ = Kind::Empty;
+}
+
+void ObjectHolder::CopyFrom(const ObjectHolder& other) {
+    switch (other.kind_) {
+    case Kind::Shared:
+        object_ = other.object_;
+        object_->AddRef();
+        break;
+    case Kind::Borrowed:
+        object_ = other.object_;
+        break;
+    case Kind::Number:
+        object_ = new (inline_) Number(static_cast<const Number&>(*other.object_));
+        break;
+    case Kind::Bool:
+        object_ = new (inline_) Bool(static_cast<const Bool&>(*other.object_));
+        break;
+    case Kind::Empty:
+        break;
+    }
+    kind_ = other.kind_;
+}
+
+ObjectHolder ObjectHolder::Own(Number object) {
+    ObjectHolder result;
+    result.object_ = new (result.inline_) Number(std::move(object));
+    result.kind_ = Kind::Number;
+    return result;
+}
+
+ObjectHolder ObjectHolder::Own(Bool object) {
+    ObjectHolder result;
+    result.object_ = new (result.inline_) Bool(std::move(object));
+    result.kind_ = Kind::Bool;
+    return result;
+}
+
+void ObjectHolder::AssertIsValid() const {
+    assert(object_ != nullptr);
+}
+
+ObjectHolder ObjectHolder::Share(Object& object) {
+    // Невладеющая ссылка: объектом владеет кто-то другой
+    ObjectHolder result;
+    result.object_ = &object;
+    result.kind_ = Kind::Borrowed;
+    return result;
+}
+
+ObjectHolder ObjectHolder::None() {
+    return ObjectHolder();
+}
+
+Object& ObjectHolder::operator*() const {
+    AssertIsValid();
+    return *Get();
+}
+
+Object* ObjectHolder::operator->() const {
+    AssertIsValid();
+    return Get();
+}
+
+Object* ObjectHolder::Get() const {
+    return object_;
+}
+
+ObjectHolder::operator bool() const {
+    return Get() != nullptr;
+}
+
+ObjectHolder MakeBool(bool value) {
+    static Bool true_object{true};
+    static Bool false_object{false};
+    return ObjectHolder::Share(value ? true_object : false_object);
+}
+
+ObjectHolder MakeNumber(int value) {
+    constexpr int min_value = -128;
+    constexpr int max_value = 1023;
+
+    if(value < min_value || value > max_value)
+        return ObjectHolder::Own(Number{value});
+
+    static auto pool = [] {
+        std::vector<Number> numbers;
+        numbers.reserve(max_value - min_value + 1);
+        for(int v = min_value; v <= max_value; ++v)
+            numbers.emplace_back(v);
+        return numbers;
+    }();
+    return ObjectHolder::Share(pool[value - min_value]);
+}
+
+bool IsTrue(const ObjectHolder& object) {
+    if(object.Get() == nullptr)
+        return false;
+
+    switch (object->GetType()) {
+    case Object::Type::Bool:
+        return static_cast<const Bool&>(*object).GetValue();
+    case Object::Type::Number:
+        return static_cast<const Number&>(*object).GetValue() != 0;
+    case Object::Type::String:
+        return static_cast<const String&>(*object).GetValue() != ""s;
+    default:
+        return false;
+    }
+}
+
+void ClassInstance::Print(std::ostream& os, Context& context) {
+    static const Symbol str_sym = Intern("__str__"s);
+    thread_local MethodCache cache;
+
+    if(const Method* method = ResolveMethod(cache, *this, str_sym, 0); method != nullptr) {
+        auto result = Call(*method, {}, context);
+        if(result.Get() != nullptr)
+            result.Get()->Print(os, context);
+        else
+            os << "None"s;
+    } else {
+        os << this;
+    }
+}
+
+bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+    auto result = cls_.GetMethod(method);
+    if(result != nullptr && result->formal_params.size() == argument_count)
+        return true;
+    return false;
+}
+
+Closure& ClassInstance::Fields() {
+    return closure_;
+}
+
+const Closure& ClassInstance::Fields() const {
+    return closure_;
+}
+
+ClassInstance::ClassInstance(const Class& cls)
+    : Object(Type::ClassInstance), cls_(cls), closure_(cls.GetFieldShape()) {
+    GetInstanceRegistry().insert(this);
+}
+
+ClassInstance::ClassInstance(const ClassInstance& other)
+    : Object(other), cls_(other.cls_), closure_(other.closure_) {
+    GetInstanceRegistry().insert(this);
+}
+
+ClassInstance::~ClassInstance() {
+    GetInstanceRegistry().erase(this);
+}
+
+ObjectHolder ClassInstance::Call(const std::string& method, ArgsView actual_args,
+                                 Context& context) {
+    auto method_ = cls_.GetMethod(method);
+    if(method_ == nullptr || method_->formal_params.size() != actual_args.size())
+        throw std::runtime_error("Not implemented"s);
+
+    return Call(*method_, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Call(const Method& method, ArgsView actual_args,
+                                 Context& context) {
+    Profiler* profiler = context.GetProfiler();
+    const auto started =
+        profiler != nullptr ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+
+    ObjectHolder result;
+    // Нативный метод вызывается напрямую, без кадра и замыкания
+    if(method.native != nullptr) {
+        result = method.native(*this, actual_args, context);
+    } else {
+        static const Symbol self_sym = Intern("self"s);
+
+        Frame frame;
+        Closure& closure = frame.Get();
+        closure[self_sym] = ObjectHolder::Share(*this);
+
+        for(size_t i = 0; i < actual_args.size(); ++i)
+            closure.insert({method.formal_param_syms[i], actual_args[i]});
+
+        result = method.body->Execute(closure, context);
+    }
+
+    if(profiler != nullptr)
+        profiler->RecordCall(cls_, method, Profiler::Clock::now() - started);
+    return result;
+}
+
+void Profiler::RecordCall(const Class& cls, const Method& method, Clock::duration elapsed) {
+    auto& stats = stats_[&method];
+    if(stats.calls == 0)
+        stats.name = cls.GetName() + "."s + method.name;
+    ++stats.calls;
+    stats.total += elapsed;
+}
+
+std::vector<Profiler::Entry> Profiler::Report() const {
+    std::vector<Entry> report;
+    report.reserve(stats_.size());
+    for(const auto& [method, stats] : stats_)
+        report.push_back({stats.name, stats.calls, stats.total});
+    std::sort(report.begin(), report.end(),
+              [](const Entry& lhs, const Entry& rhs) { return lhs.total > rhs.total; });
+    return report;
+}
+
+void Profiler::Dump(std::ostream& os) const {
+    os << "     calls    total ms      avg us  method\n"s;
+    for(const auto& entry : Report()) {
+        const double total_ms = std::chrono::duration<double, std::milli>(entry.total).count();
+        os << std::setw(10) << entry.calls << std::setw(12) << std::fixed << std::setprecision(3)
+           << total_ms << std::setw(12) << std::setprecision(1)
+           << total_ms * 1000.0 / static_cast<double>(entry.calls) << "  "s << entry.name
+           << "\n"s;
+    }
+}
+
+/*
+ * Сборщик циклов: пробное удаление по реестру живых экземпляров.
+ * Для каждого экземпляра подсчитывается число владеющих ссылок из полей
+ * других экземпляров; экземпляры, у которых счётчик ссылок больше этого
+ * числа, достижимы извне и служат корнями разметки. Неразмеченные
+ * экземпляры образуют недостижимые циклы: их поля очищаются, после чего
+ * обычный подсчёт ссылок освобождает весь граф
+ */
+class CycleCollector {
+public:
+    std::size_t Collect() {
+        auto& registry = GetInstanceRegistry();
+
+        std::unordered_map<ClassInstance*, std::uint32_t> internal_refs;
+        internal_refs.reserve(registry.size());
+        for(ClassInstance* instance : registry)
+            VisitValues(instance->Fields(), [&](const ObjectHolder& value) {
+                if(ClassInstance* target = OwnedInstance(value); target != nullptr)
+                    ++internal_refs[target];
+            });
+
+        // Корни: экземпляры со ссылками извне (из замыканий, переменных C++)
+        std::vector<ClassInstance*> frontier;
+        std::unordered_set<ClassInstance*> reachable;
+        for(ClassInstance* instance : registry)
+            if(instance->refs_ > InternalRefs(internal_refs, instance)) {
+                reachable.insert(instance);
+                frontier.push_back(instance);
+            }
+
+        while(!frontier.empty()) {
+            ClassInstance* instance = frontier.back();
+            frontier.pop_back();
+            VisitValues(instance->Fields(), [&](const ObjectHolder& value) {
+                if(ClassInstance* target = OwnedInstance(value);
+                   target != nullptr && reachable.insert(target).second)
+                    frontier.push_back(target);
+            });
+        }
+
+        std::vector<ClassInstance*> garbage;
+        for(ClassInstance* instance : registry)
+            if(reachable.count(instance) == 0)
+                garbage.push_back(instance);
+
+        // Мусор придерживается дополнительной ссылкой: очистка полей одного
+        // экземпляра не должна разрушить соседей до конца обхода
+        for(ClassInstance* instance : garbage)
+            instance->AddRef();
+        for(ClassInstance* instance : garbage)
+            instance->Fields().clear();
+        for(ClassInstance* instance : garbage)
+            if(instance->ReleaseRef()) {
+                UnchargeObject(*instance);
+                delete instance;
+            }
+
+        return garbage.size();
+    }
+
+private:
+    // Возвращает экземпляр, которым владеет holder, либо nullptr
+    static ClassInstance* OwnedInstance(const ObjectHolder& holder) {
+        if(holder.kind_ != ObjectHolder::Kind::Shared)
+            return nullptr;
+        return holder.TryAs<ClassInstance>();
+    }
+
+    // Обходит значения полей, не обращаясь к именам: Shape класса утёкшего
+    // экземпляра может быть уже разрушен вместе с программой
+    template <typename Visit>
+    static void VisitValues(Closure& fields, Visit visit) {
+        for(std::size_t slot = 0; slot < fields.slots_.size(); ++slot)
+            if(fields.present_[slot])
+                visit(fields.slots_[slot]);
+        for(auto& [name, value] : fields.data_)
+            visit(value);
+    }
+
+    static std::uint32_t InternalRefs(
+        const std::unordered_map<ClassInstance*, std::uint32_t>& internal_refs,
+        ClassInstance* instance) {
+        auto it = internal_refs.find(instance);
+        return it != internal_refs.end() ? it->second : 0;
+    }
+};
+
+std::size_t CollectCycles() {
+    return CycleCollector{}.Collect();
+}
+
+MemoryUsage GetMemoryUsage() {
+    return GetMemoryAccounting().usage;
+}
+
+void ResetPeakMemoryUsage() {
+    auto& accounting = GetMemoryAccounting();
+    accounting.usage.peak_live_bytes = accounting.usage.total_live_bytes;
+}
+
+void SetMemoryLimit(std::uint64_t limit_bytes) {
+    GetMemoryAccounting().limit = limit_bytes;
+}
+
+MethodCache::~MethodCache() {
+    const Entry* entry = head_.load(std::memory_order_relaxed);
+    while(entry != nullptr) {
+        const Entry* next = entry->next;
+        delete entry;
+        entry = next;
+    }
+}
+
+const Method* ResolveMethod(MethodCache& cache, const ClassInstance& object, Symbol name,
+                            std::size_t argument_count) {
+    const Class& cls = object.GetClass();
+    const MethodCache::Entry* entry = cache.head_.load(std::memory_order_acquire);
+    if(entry == nullptr || entry->cls_id != cls.Id()) {
+        // Промах по голове: класс мог встречаться здесь раньше, запись
+        // ищется в списке прежде, чем выделять новую, - кеш ограничен
+        // числом различных классов, увиденных этой точкой вызова
+        const MethodCache::Entry* found = nullptr;
+        for(const MethodCache::Entry* it = entry; it != nullptr; it = it->next)
+            if(it->cls_id == cls.Id()) {
+                found = it;
+                break;
+            }
+        if(found == nullptr) {
+            // Новая запись публикуется в голове списка. При гонке
+            // нескольких потоков каждая запись попадает в список и не теряется
+            auto* fresh = new MethodCache::Entry{cls.Id(), cls.GetMethod(name), entry};
+            while(!cache.head_.compare_exchange_weak(fresh->next, fresh,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+            }
+            found = fresh;
+        }
+        entry = found;
+    }
+
+    if(entry->method != nullptr && entry->method->formal_params.size() == argument_count)
+        return entry->method;
+    return nullptr;
+}
+
+FieldCache::~FieldCache() {
+    const Entry* entry = head_.load(std::memory_order_relaxed);
+    while(entry != nullptr) {
+        const Entry* next = entry->next;
+        delete entry;
+        entry = next;
+    }
+}
+
+ObjectHolder* ResolveField(FieldCache& cache, ClassInstance& object, Symbol name) {
+    const Class& cls = object.GetClass();
+    const FieldCache::Entry* entry = cache.head_.load(std::memory_order_acquire);
+    if(entry == nullptr || entry->cls_id != cls.Id()) {
+        // Промах по голове: запись ищется в списке прежде, чем выделять
+        // новую, - кеш ограничен числом различных классов, увиденных
+        // этой точкой доступа
+        const FieldCache::Entry* found = nullptr;
+        for(const FieldCache::Entry* it = entry; it != nullptr; it = it->next)
+            if(it->cls_id == cls.Id()) {
+                found = it;
+                break;
+            }
+        if(found == nullptr) {
+            const auto& slots = cls.GetFieldShape().slots;
+            const auto it = slots.find(name);
+            const std::size_t slot = it != slots.end() ? it->second : FieldCache::kNoSlot;
+            // Новая запись публикуется в голове списка. При гонке
+            // нескольких потоков каждая запись попадает в список и не теряется
+            auto* fresh = new FieldCache::Entry{cls.Id(), slot, entry};
+            while(!cache.head_.compare_exchange_weak(fresh->next, fresh,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+            }
+            found = fresh;
+        }
+        entry = found;
+    }
+    Closure& fields = object.Fields();
+    if(entry->slot != FieldCache::kNoSlot)
+        return fields.SlotValue(entry->slot);
+    // Имя вне формы класса хранится в хеш-таблице
+    if(auto it = fields.find(name); it != fields.end())
+        return &it->second;
+    return nullptr;
+}
+
+namespace {
+
+// Хранилище нативных классов: deque не перемещает элементы при росте,
+// ссылки и указатели на классы остаются действительными
+struct NativeClassRegistry {
+    std::mutex guard;
+    std::deque<Class> classes;
+    std::vector<const Class*> index;
+};
+
+NativeClassRegistry& GetNativeClassRegistry() {
+    static NativeClassRegistry registry;
+    return registry;
+}
+
+}  // namespace
+
+const Class& RegisterNativeClass(Class cls) {
+    auto& registry = GetNativeClassRegistry();
+    std::lock_guard lock(registry.guard);
+    registry.classes.push_back(std::move(cls));
+    registry.index.push_back(&registry.classes.back());
+    return registry.classes.back();
+}
+
+const std::vector<const Class*>& NativeClasses() {
+    // Чтение без блокировки: регистрация завершается до разбора программ
+    return GetNativeClassRegistry().index;
+}
+
+Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
+    : Object(Type::Class), name_(name), methods_(std::move(methods)), parent_(parent) {
+    // Атомарный счётчик: классы могут создаваться параллельно разными
+    // интерпретаторами
+    static std::atomic<std::uint64_t> next_id{0};
+    id_ = next_id.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    for(auto& method : methods_) {
+        method.formal_param_syms.clear();
+        for(const auto& param : method.formal_params)
+            method.formal_param_syms.push_back(Intern(param));
+    }
+
+    // Унаследованные методы копируются в таблицу, собственные их перекрывают
+    if(parent_ != nullptr)
+        method_table_ = parent_->method_table_;
+    for(const auto& method : methods_)
+        method_table_[Intern(method.name)] = &method;
+
+    // Форма полей: слоты родителя плюс поля, присваиваемые self
+    // в телах собственных методов
+    if(parent_ != nullptr)
+        for(const auto name : parent_->field_shape_.names)
+            field_shape_.AddField(name);
+
+    std::vector<Symbol> fields;
+    for(const auto& method : methods_)
+        if(method.body != nullptr)
+            method.body->CollectSelfFields(fields);
+    for(const auto name : fields)
+        field_shape_.AddField(name);
+}
+
+const Method* Class::GetMethod(const std::string& name) const {
+    return GetMethod(Intern(name));
+}
+
+const Method* Class::GetMethod(Symbol name) const {
+    if(auto it = method_table_.find(name); it != method_table_.end())
+        return it->second;
+    return nullptr;
+}
+
+[[nodiscard]] const std::string& Class::GetName() const {
+    return name_;
+}
+
+void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
+    os << "Class "s << name_;
+}
+
+void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+    os << (GetValue() ? "True"sv : "False"sv);
+}
+
+void OutputBuffer::AppendNumber(int value) {
+    char digits[16];
+    auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), value);
+    (void)ec;  // int всегда помещается в digits
+    buffer_.append(digits, end - digits);
+    if(buffer_.size() >= kFlushThreshold)
+        Flush();
+}
+
+void OutputBuffer::Flush() {
+    if(buffer_.empty()) return;
+    output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+
+    if(!lhs.operator bool()) {
+        if(!rhs.operator bool()) return true;
+        else throw std::runtime_error("Cannot compare objects for equality"s);
+    }
+
+    switch (lhs->GetType()) {
+    case Object::Type::Bool:
+        if(auto rhs_ = rhs.TryAs<Bool>(); rhs_ != nullptr)
+            return static_cast<const Bool&>(*lhs).GetValue() == rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    case Object::Type::Number:
+        if(auto rhs_ = rhs.TryAs<Number>(); rhs_ != nullptr)
+            return static_cast<const Number&>(*lhs).GetValue() == rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    case Object::Type::String:
+        if(auto rhs_ = rhs.TryAs<String>(); rhs_ != nullptr)
+            return static_cast<const String&>(*lhs).GetValue() == rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    case Object::Type::ClassInstance: {
+        auto& lhs_ = static_cast<ClassInstance&>(*lhs);
+        static const Symbol eq_sym = Intern("__eq__"s);
+        thread_local MethodCache cache;
+        if(const Method* method = ResolveMethod(cache, lhs_, eq_sym, 1); method != nullptr) {
+            auto result = lhs_.Call(*method, ArgsView(&rhs, 1), context);
+            return result.TryAs<Bool>()->GetValue();
+        }
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    }
+    default:
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    }
+}
+
+bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+
+    if(!lhs.operator bool())
+        throw std::runtime_error("Cannot compare objects for less"s);
+
+    switch (lhs->GetType()) {
+    case Object::Type::Bool:
+        if(auto rhs_ = rhs.TryAs<Bool>(); rhs_ != nullptr)
+            return static_cast<const Bool&>(*lhs).GetValue() < rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for less"s);
+    case Object::Type::Number:
+        if(auto rhs_ = rhs.TryAs<Number>(); rhs_ != nullptr)
+            return static_cast<const Number&>(*lhs).GetValue() < rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for less"s);
+    case Object::Type::String:
+        if(auto rhs_ = rhs.TryAs<String>(); rhs_ != nullptr)
+            return static_cast<const String&>(*lhs).GetValue() < rhs_->GetValue();
+        throw std::runtime_error("Cannot compare objects for less"s);
+    case Object::Type::ClassInstance: {
+        auto& lhs_ = static_cast<ClassInstance&>(*lhs);
+        static const Symbol lt_sym = Intern("__lt__"s);
+        thread_local MethodCache cache;
+        if(const Method* method = ResolveMethod(cache, lhs_, lt_sym, 1); method != nullptr) {
+            auto result = lhs_.Call(*method, ArgsView(&rhs, 1), context);
+            return result.TryAs<Bool>()->GetValue();
+        }
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    }
+    default:
+        throw std::runtime_error("Cannot compare objects for less"s);
+    }
+}
+
+ObjectHolder ConcatStrings(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    auto* head = static_cast<String*>(lhs.Get());
+    const auto& tail = static_cast<const String*>(rhs.Get())->GetValue();
+    // Временный результат предыдущей конкатенации наращивается на месте:
+    // рост буфера строки амортизирован, накопленный префикс не копируется
+    if(lhs.IsUniqueOwner()) {
+        std::string& value = head->MutableValue();
+        const auto old_capacity = value.capacity();
+        value += tail;
+        if(value.capacity() != old_capacity)
+            ChargeStringGrowth(value.capacity() - old_capacity);
+        return lhs;
+    }
+    std::string value;
+    value.reserve(head->GetValue().size() + tail.size());
+    value = head->GetValue();
+    value += tail;
+    return ObjectHolder::Own(String{std::move(value)});
+}
+
+ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    {
+        auto lhs_ = lhs.TryAs<Number>();
+        if(lhs_ != nullptr) {
+            auto rhs_ = rhs.TryAs<Number>();
+            if(rhs_ != nullptr)
+                return MakeNumber(lhs_->GetValue() + rhs_->GetValue());
+            else
+                throw runtime_error("Add(Number, ?)"s);
+        }
+    }
+    {
+        auto lhs_ = lhs.TryAs<String>();
+        if(lhs_ != nullptr) {
+            auto rhs_ = rhs.TryAs<String>();
+            if(rhs_ != nullptr)
+                return ConcatStrings(lhs, rhs);
+            else
+                throw runtime_error("Add(String, ?)"s);
+        }
+    }
+    {
+        auto lhs_ = lhs.TryAs<ClassInstance>();
+        if(lhs_ != nullptr) {
+            static const Symbol add_sym = Intern("__add__"s);
+            thread_local MethodCache cache;
+            if(const Method* method = ResolveMethod(cache, *lhs_, add_sym, 1); method != nullptr)
+                return lhs_->Call(*method, ArgsView(&rhs, 1), context);
+        }
+    }
+    throw runtime_error("Add(?, ?)"s);
+}
+
+ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs, [[maybe_unused]] Context& context) {
+    auto lhs_ = lhs.TryAs<Number>();
+    if(lhs_ != nullptr) {
+        auto rhs_ = rhs.TryAs<Number>();
+        if(rhs_ != nullptr)
+            return MakeNumber(lhs_->GetValue() - rhs_->GetValue());
+        else
+            throw runtime_error("Sub(Number, ?)"s);
+    }
+    throw runtime_error("Sub(?, ?)"s);
+}
+
+ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs, [[maybe_unused]] Context& context) {
+    auto lhs_ = lhs.TryAs<Number>();
+    if(lhs_ != nullptr) {
+        auto rhs_ = rhs.TryAs<Number>();
+        if(rhs_ != nullptr)
+            return MakeNumber(lhs_->GetValue() * rhs_->GetValue());
+        else
+            throw runtime_error("Mult(Number, ?)"s);
+    }
+    throw runtime_error("Mult(?, ?)"s);
+}
+
+ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs, [[maybe_unused]] Context& context) {
+    auto lhs_ = lhs.TryAs<Number>();
+    if(lhs_ != nullptr) {
+        auto rhs_ = rhs.TryAs<Number>();
+        if(rhs_ != nullptr) {
+            if(rhs_->GetValue() == 0)
+                throw runtime_error("Div(Number, 0): divide by zero"s);
+
+            return MakeNumber(lhs_->GetValue() / rhs_->GetValue());
+        } else
+            throw runtime_error("Div(Number, ?)"s);
+    }
+    throw runtime_error("Div(?, ?)"s);
+}
+
+bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return !Equal(lhs, rhs, context);
+}
+
+bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return !Less(lhs, rhs, context) && !Equal(lhs, rhs, context);
+}
+
+bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return !Greater(lhs, rhs, context);
+}
+
+bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return !Less(lhs, rhs, context);
+}
+
+}  // namespace runtime
@@ -1,242 +1,1156 @@
-#pragma once
-
-#include <memory>
-#include <sstream>
-#include <string>
-#include <unordered_map>
-#include <vector>
-
-using namespace std::literals;
-
-namespace runtime {
-
-// Контекст исполнения инструкций Mython
-class Context {
-public:
-    // Возвращает поток вывода для команд print
-    virtual std::ostream& GetOutputStream() = 0;
-
-protected:
-    ~Context() = default;
-};
-
-// Базовый класс для всех объектов языка Mython
-class Object {
-public:
-    virtual ~Object() = default;
-    // выводит в os своё представление в виде строки
-    virtual void Print(std::ostream& os, [[maybe_unused]] Context& context) = 0;
-};
-
-// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
-class ObjectHolder {
-public:
-    // Создаёт пустое значение
-    ObjectHolder() = default;
-
-    // Возвращает ObjectHolder, владеющий объектом типа T
-    // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
-    template <typename T>
-    [[nodiscard]] static ObjectHolder Own(T&& object) {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
-    }
-
-    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
-    [[nodiscard]] static ObjectHolder Share(Object& object);
-    // Создаёт пустой ObjectHolder, соответствующий значению None
-    [[nodiscard]] static ObjectHolder None();
-
-    // Возвращает ссылку на Object внутри ObjectHolder.
-    // ObjectHolder должен быть непустым
-    Object& operator*() const;
-
-    Object* operator->() const;
-
-    [[nodiscard]] Object* Get() const;
-
-    // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-    // объект данного типа
-    template <typename T>
-    [[nodiscard]] T* TryAs() const {
-        return dynamic_cast<T*>(this->Get());
-    }
-
-    // Возвращает true, если ObjectHolder не пуст
-    explicit operator bool() const;
-
-private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
-    void AssertIsValid() const;
-
-    std::shared_ptr<Object> data_;
-};
-
-// Объект-значение, хранящий значение типа T
-template <typename T>
-class ValueObject : public Object {
-public:
-    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-        : value_(v) {
-    }
-
-    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-        os << value_;
-    }
-
-    [[nodiscard]] const T& GetValue() const {
-        return value_;
-    }
-
-private:
-    T value_;
-};
-
-// Таблица символов, связывающая имя объекта с его значением
-using Closure = std::unordered_map<std::string, ObjectHolder>;
-
-// Проверяет, содержится ли в object значение, приводимое к True
-// Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
-bool IsTrue(const ObjectHolder& object);
-
-// Интерфейс для выполнения действий над объектами Mython
-class Executable {
-public:
-    virtual ~Executable() = default;
-    // Выполняет действие над объектами внутри closure, используя context
-    // Возвращает результирующее значение либо None
-    virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
-};
-
-// Строковое значение
-using String = ValueObject<std::string>;
-// Числовое значение
-using Number = ValueObject<int>;
-
-// Логическое значение
-class Bool : public ValueObject<bool> {
-public:
-    using ValueObject<bool>::ValueObject;
-
-    void Print(std::ostream& os, [[maybe_unused]] Context& context) override;
-};
-
-// Метод класса
-struct Method {
-    // Имя метода
-    std::string name;
-    // Имена формальных параметров метода
-    std::vector<std::string> formal_params;
-    // Тело метода
-    std::unique_ptr<Executable> body;
-};
-
-// Класс
-class Class : public Object {
-public:
-    // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
-    // Если parent равен nullptr, то создаётся базовый класс
-    explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
-
-    // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-    [[nodiscard]] const Method* GetMethod(const std::string& name) const;
-
-    // Возвращает имя класса
-    [[nodiscard]] const std::string& GetName() const;
-
-    // Выводит в os строку "Class <имя класса>", например "Class cat"
-    void Print(std::ostream& os, [[maybe_unused]] Context& context) override;
-
-private:
-    std::string name_ = ""s;
-    std::vector<Method> methods_;
-    const Class* parent_ = nullptr;
-};
-
-// Экземпляр класса
-class ClassInstance : public Object {
-public:
-    explicit ClassInstance(const Class& cls);
-
-    /*
-     * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
-     * В противном случае в os выводится адрес объекта.
-     */
-    void Print(std::ostream& os, Context& context) override;
-
-    /*
-     * Вызывает у объекта метод method, передавая ему actual_args параметров.
-     * Параметр context задаёт контекст для выполнения метода.
-     * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
-     * runtime_error
-     */
-    ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
-                      Context& context);
-
-    // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-    [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
-
-    // Возвращает ссылку на Closure, содержащий поля объекта
-    [[nodiscard]] Closure& Fields();
-    // Возвращает константную ссылку на Closure, содержащую поля объекта
-    [[nodiscard]] const Closure& Fields() const;
-
-private:
-    const Class& cls_;
-    Closure closure_;
-};
-
-/*
- * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
- * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
- * приведённый к типу Bool. Если lhs и rhs имеют значение None, функция возвращает true.
- * В остальных случаях функция выбрасывает исключение runtime_error.
- *
- * Параметр context задаёт контекст для выполнения метода __eq__
- */
-bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-/*
- * Если lhs и rhs - числа, строки или значения bool, функция возвращает результат их сравнения
- * оператором <.
- * Если lhs - объект с методом __lt__, возвращает результат вызова lhs.__lt__(rhs),
- * приведённый к типу bool. В остальных случаях функция выбрасывает исключение runtime_error.
- *
- * Параметр context задаёт контекст для выполнения метода __lt__
- */
-bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение, противоположное Equal(lhs, rhs, context)
-bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs>rhs, используя функции Equal и Less
-bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs<=rhs, используя функции Equal и Less
-bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение, противоположное Less(lhs, rhs, context)
-bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-
-// Контекст-заглушка, применяется в тестах.
-// В этом контексте весь вывод перенаправляется в строковый поток вывода output
-struct DummyContext : Context {
-    std::ostream& GetOutputStream() override {
-        return output;
-    }
-
-    std::ostringstream output;
-};
-
-// Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
-class SimpleContext : public runtime::Context {
-public:
-    explicit SimpleContext(std::ostream& output)
-        : output_(output) {
-    }
-
-    std::ostream& GetOutputStream() override {
-        return output_;
-    }
-
-private:
-    std::ostream& output_;
-};
-
-}  // namespace runtime
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::literals;
+
+namespace vm {
+class Compiler;
+}
+
+namespace runtime {
+
+// Буфер вывода: накапливает готовые байты в собственной строке и сбрасывает
+// их в поток крупными блоками одной записью. Числа форматируются через
+// std::to_chars, минуя форматирование iostream
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& output)
+        : output_(output) {
+        buffer_.reserve(kFlushThreshold);
+    }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() {
+        Flush();
+    }
+
+    // Дописывает текст в буфер
+    void Append(std::string_view text) {
+        buffer_.append(text);
+        if(buffer_.size() >= kFlushThreshold)
+            Flush();
+    }
+
+    // Дописывает одиночный символ в буфер
+    void Append(char c) {
+        buffer_.push_back(c);
+        if(buffer_.size() >= kFlushThreshold)
+            Flush();
+    }
+
+    // Дописывает десятичную запись числа value в буфер
+    void AppendNumber(int value);
+
+    // Записывает накопленное в поток одним блоком и опустошает буфер
+    void Flush();
+
+private:
+    static constexpr std::size_t kFlushThreshold = 64 * 1024;
+
+    std::ostream& output_;
+    std::string buffer_;
+};
+
+// Контекст исполнения инструкций Mython
+class Profiler;
+
+class Context {
+public:
+    // Возвращает поток вывода для команд print
+    virtual std::ostream& GetOutputStream() = 0;
+
+    // Возвращает буфер быстрого вывода либо nullptr,
+    // если контекст его не поддерживает
+    virtual OutputBuffer* GetOutputBuffer() {
+        return nullptr;
+    }
+
+    // Возвращает профилировщик исполнения либо nullptr,
+    // если профилирование выключено
+    virtual Profiler* GetProfiler() {
+        return nullptr;
+    }
+
+protected:
+    ~Context() = default;
+};
+
+// Базовый класс для всех объектов языка Mython
+class Object {
+public:
+    // Тег типа объекта, назначается при конструировании.
+    // Позволяет проверять тип сравнением тега вместо dynamic_cast
+    enum class Type {
+        Number,
+        String,
+        Bool,
+        Class,
+        ClassInstance,
+        Other,
+    };
+
+    Object() = default;
+    virtual ~Object() = default;
+
+    // Копия объекта начинает жизнь без владеющих ссылок
+    Object(const Object& other)
+        : type_(other.type_) {
+    }
+
+    Object& operator=(const Object&) {
+        // Тег типа задаётся при конструировании, счётчик ссылок не копируется
+        return *this;
+    }
+
+    [[nodiscard]] Type GetType() const {
+        return type_;
+    }
+
+    // выводит в os своё представление в виде строки
+    virtual void Print(std::ostream& os, [[maybe_unused]] Context& context) = 0;
+
+protected:
+    explicit Object(Type type)
+        : type_(type) {
+    }
+
+private:
+    friend class ObjectHolder;
+    friend class CycleCollector;
+
+// Встроенный счётчик ссылок владеющих ObjectHolder. По умолчанию неатомарный:
+// объекты Mython-программы создаются и умирают в куче одного потока, а
+// разделяемые между потоками значения (константы AST, пулы Number и Bool,
+// объекты классов) передаются невладеющими ссылками и счётчик не трогают.
+// Сборка с -DMYTHON_ATOMIC_REFCOUNT возвращает атомарный счётчик для
+// случаев, когда владеющие ссылки всё же пересекают границы потоков
+#ifdef MYTHON_ATOMIC_REFCOUNT
+    using RefCount = std::atomic<std::uint32_t>;
+#else
+    using RefCount = std::uint32_t;
+#endif
+
+    void AddRef() const {
+        ++refs_;
+    }
+
+    // Возвращает true, если снята последняя владеющая ссылка
+    [[nodiscard]] bool ReleaseRef() const {
+        return --refs_ == 0;
+    }
+
+    Type type_ = Type::Other;
+    mutable RefCount refs_{0};
+};
+
+namespace detail {
+
+// Сопоставляет классу объекта его тег; специализируется ниже для встроенных типов.
+// Для типов без специализации ObjectHolder::TryAs откатывается к dynamic_cast
+template <typename T>
+struct ObjectTypeTag;
+
+template <typename T, typename = void>
+struct HasTypeTag : std::false_type {};
+
+template <typename T>
+struct HasTypeTag<T, std::void_t<decltype(ObjectTypeTag<T>::value)>> : std::true_type {};
+
+}  // namespace detail
+
+namespace detail {
+
+// Тег ValueObject<T> по типу хранимого значения
+template <typename T>
+constexpr Object::Type ValueTypeTag() {
+    if constexpr (std::is_same_v<T, int>) {
+        return Object::Type::Number;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return Object::Type::String;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return Object::Type::Bool;
+    } else {
+        return Object::Type::Other;
+    }
+}
+
+}  // namespace detail
+
+// Объект-значение, хранящий значение типа T
+template <typename T>
+class ValueObject : public Object {
+public:
+    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : Object(detail::ValueTypeTag<T>()), value_(std::move(v)) {
+    }
+
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+        os << value_;
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return value_;
+    }
+
+protected:
+    T value_;
+};
+
+class ObjectHolder;
+
+// Строковое значение. Для Mython-программы строки неизменяемы; наращивать
+// буфер на месте разрешено только конкатенации, когда держатель левого
+// операнда - единственный владелец
+class String : public ValueObject<std::string> {
+public:
+    using ValueObject<std::string>::ValueObject;
+
+private:
+    friend ObjectHolder ConcatStrings(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+    std::string& MutableValue() {
+        return value_;
+    }
+};
+// Числовое значение
+using Number = ValueObject<int>;
+
+// Логическое значение
+class Bool : public ValueObject<bool> {
+public:
+    using ValueObject<bool>::ValueObject;
+
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override;
+};
+
+// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+class ObjectHolder {
+public:
+    // Создаёт пустое значение
+    ObjectHolder() = default;
+
+    ObjectHolder(const ObjectHolder& other);
+    ObjectHolder(ObjectHolder&& other) noexcept;
+    ObjectHolder& operator=(const ObjectHolder& other);
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept;
+    ~ObjectHolder();
+
+    // Возвращает ObjectHolder, владеющий объектом типа T
+    // Тип T - конкретный класс-наследник Object.
+    // object копируется или перемещается в кучу
+    template <typename T>
+    [[nodiscard]] static ObjectHolder Own(T&& object) {
+        return ObjectHolder(static_cast<Object*>(new std::decay_t<T>(std::forward<T>(object))));
+    }
+
+    // Для Number и Bool значение размещается внутри самого ObjectHolder:
+    // арифметика и логические выражения не обращаются к куче
+    [[nodiscard]] static ObjectHolder Own(Number object);
+    [[nodiscard]] static ObjectHolder Own(Bool object);
+
+    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
+    [[nodiscard]] static ObjectHolder Share(Object& object);
+    // Создаёт пустой ObjectHolder, соответствующий значению None
+    [[nodiscard]] static ObjectHolder None();
+
+    // Возвращает ссылку на Object внутри ObjectHolder.
+    // ObjectHolder должен быть непустым
+    Object& operator*() const;
+
+    Object* operator->() const;
+
+    [[nodiscard]] Object* Get() const;
+
+    // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
+    // объект данного типа
+    template <typename T>
+    [[nodiscard]] T* TryAs() const {
+        if constexpr (detail::HasTypeTag<T>::value) {
+            auto* obj = this->Get();
+            if(obj != nullptr && obj->GetType() == detail::ObjectTypeTag<T>::value)
+                return static_cast<T*>(obj);
+            return nullptr;
+        } else {
+            return dynamic_cast<T*>(this->Get());
+        }
+    }
+
+    // Возвращает true, если ObjectHolder не пуст
+    explicit operator bool() const;
+
+    // Возвращает true, если держатель владеет объектом - возможно,
+    // совместно с другими владеющими держателями
+    [[nodiscard]] bool IsOwning() const {
+        return kind_ == Kind::Shared;
+    }
+
+    // Возвращает true, если держатель - единственная владеющая ссылка
+    // на объект: мутация объекта не наблюдаема извне
+    [[nodiscard]] bool IsUniqueOwner() const {
+        return kind_ == Kind::Shared && object_->refs_ == 1;
+    }
+
+private:
+    enum class Kind : std::uint8_t {
+        Empty,
+        Shared,
+        Borrowed,
+        Number,
+        Bool,
+    };
+
+    friend class CycleCollector;
+
+    // Принимает владение объектом owned, созданным оператором new
+    explicit ObjectHolder(Object* owned);
+    void AssertIsValid() const;
+    // Освобождает текущее содержимое, состояние становится Empty
+    void Reset();
+    // Копирует содержимое other; предполагает состояние Empty
+    void CopyFrom(const ObjectHolder& other);
+
+    static constexpr std::size_t kInlineSize =
+        sizeof(Number) > sizeof(Bool) ? sizeof(Number) : sizeof(Bool);
+
+    Object* object_ = nullptr;
+    Kind kind_ = Kind::Empty;
+    alignas(std::max_align_t) unsigned char inline_[kInlineSize];
+};
+
+// Идентификатор имени (переменной, поля, метода), полученный интернированием строки
+using Symbol = std::uint32_t;
+
+// Значение Symbol, не соответствующее ни одному имени
+inline constexpr Symbol kNoSymbol = std::numeric_limits<Symbol>::max();
+
+// Возвращает идентификатор имени name. Одинаковым строкам соответствует один
+// идентификатор, поэтому горячие пути сравнивают и хешируют целые числа,
+// а не строки
+Symbol Intern(const std::string& name);
+
+// Возвращает строку, соответствующую идентификатору symbol
+const std::string& SymbolName(Symbol symbol);
+
+/*
+ * Таблица символов, связывающая имя объекта с его значением.
+ * Ключом служит интернированный Symbol; перегрузки со строками интернируют
+ * имя на месте.
+ *
+ * Таблице может быть придана статическая форма (Shape): перечисленные в ней
+ * имена хранятся в непрерывном векторе слотов и находятся по индексу, без
+ * хеш-таблицы. Имена вне формы попадают в обычную хеш-таблицу
+ */
+class Closure {
+public:
+    using Storage = std::unordered_map<Symbol, ObjectHolder>;
+
+    class iterator;
+    using const_iterator = iterator;
+
+    // Форма: отображение имени в фиксированный индекс слота
+    struct Shape {
+        std::unordered_map<Symbol, std::uint32_t> slots;
+        // Имя слота по индексу
+        std::vector<Symbol> names;
+
+        // Добавляет поле name, если его ещё нет в форме
+        void AddField(Symbol name) {
+            if(slots.emplace(name, static_cast<std::uint32_t>(names.size())).second)
+                names.push_back(name);
+        }
+    };
+
+    // Итератор по занятым слотам и элементам хеш-таблицы
+    class iterator {
+    public:
+        // Пара имя-значение, на которую указывает итератор
+        struct EntryRef {
+            Symbol first;
+            ObjectHolder& second;
+
+            EntryRef* operator->() {
+                return this;
+            }
+        };
+
+        iterator() = default;
+
+        EntryRef operator*() const {
+            if(slot_ != kNoSlot)
+                return {owner_->shape_->names[slot_], owner_->slots_[slot_]};
+            return {it_->first, it_->second};
+        }
+
+        EntryRef operator->() const {
+            return **this;
+        }
+
+        iterator& operator++() {
+            if(slot_ != kNoSlot) {
+                slot_ = owner_->NextPresentSlot(slot_ + 1);
+                if(slot_ == kNoSlot)
+                    it_ = owner_->data_.begin();
+            } else {
+                ++it_;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& rhs) const {
+            return slot_ == rhs.slot_ && (slot_ != kNoSlot || it_ == rhs.it_);
+        }
+        bool operator!=(const iterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class Closure;
+
+        static constexpr std::size_t kNoSlot = std::numeric_limits<std::size_t>::max();
+
+        iterator(Closure* owner, std::size_t slot, Storage::iterator it)
+            : owner_(owner), slot_(slot), it_(it) {
+        }
+
+        Closure* owner_ = nullptr;
+        std::size_t slot_ = kNoSlot;
+        Storage::iterator it_{};
+    };
+
+    Closure() = default;
+
+    // Таблица с формой shape; shape должна пережить таблицу
+    explicit Closure(const Shape& shape)
+        : shape_(&shape), slots_(shape.names.size()), present_(shape.names.size(), 0) {
+    }
+
+    Closure(std::initializer_list<std::pair<std::string, ObjectHolder>> items) {
+        for(const auto& [name, value] : items)
+            data_[Intern(name)] = value;
+    }
+
+    ObjectHolder& operator[](Symbol symbol) {
+        if(const auto slot = FindSlot(symbol); slot != iterator::kNoSlot) {
+            if(!present_[slot]) {
+                present_[slot] = 1;
+                ++slots_used_;
+            }
+            return slots_[slot];
+        }
+        return data_[symbol];
+    }
+    ObjectHolder& operator[](const std::string& name) {
+        return (*this)[Intern(name)];
+    }
+
+    ObjectHolder& at(Symbol symbol) {
+        if(const auto slot = FindSlot(symbol); slot != iterator::kNoSlot) {
+            if(!present_[slot])
+                throw std::out_of_range("Closure::at"s);
+            return slots_[slot];
+        }
+        return data_.at(symbol);
+    }
+    [[nodiscard]] const ObjectHolder& at(Symbol symbol) const {
+        if(const auto slot = FindSlot(symbol); slot != iterator::kNoSlot) {
+            if(!present_[slot])
+                throw std::out_of_range("Closure::at"s);
+            return slots_[slot];
+        }
+        return data_.at(symbol);
+    }
+    ObjectHolder& at(const std::string& name) {
+        return at(Intern(name));
+    }
+    [[nodiscard]] const ObjectHolder& at(const std::string& name) const {
+        return at(Intern(name));
+    }
+
+    iterator find(Symbol symbol) {
+        if(const auto slot = FindSlot(symbol); slot != iterator::kNoSlot)
+            return present_[slot] ? iterator(this, slot, data_.begin()) : end();
+        return {this, iterator::kNoSlot, data_.find(symbol)};
+    }
+    iterator find(const std::string& name) {
+        return find(Intern(name));
+    }
+    // Константные перегрузки выдают тот же iterator: отдельного
+    // const_iterator у таблицы нет
+    [[nodiscard]] iterator find(Symbol symbol) const {
+        return const_cast<Closure*>(this)->find(symbol);
+    }
+    [[nodiscard]] iterator find(const std::string& name) const {
+        return const_cast<Closure*>(this)->find(Intern(name));
+    }
+
+    [[nodiscard]] std::size_t count(Symbol symbol) const {
+        if(const auto slot = FindSlot(symbol); slot != iterator::kNoSlot)
+            return present_[slot] ? 1 : 0;
+        return data_.count(symbol);
+    }
+    [[nodiscard]] std::size_t count(const std::string& name) const {
+        return count(Intern(name));
+    }
+
+    std::pair<iterator, bool> insert(std::pair<Symbol, ObjectHolder> item) {
+        if(const auto slot = FindSlot(item.first); slot != iterator::kNoSlot) {
+            if(present_[slot])
+                return {iterator(this, slot, data_.begin()), false};
+            present_[slot] = 1;
+            ++slots_used_;
+            slots_[slot] = std::move(item.second);
+            return {iterator(this, slot, data_.begin()), true};
+        }
+        auto [it, inserted] = data_.insert(std::move(item));
+        return {iterator(this, iterator::kNoSlot, it), inserted};
+    }
+    std::pair<iterator, bool> insert(std::pair<std::string, ObjectHolder> item) {
+        return insert({Intern(item.first), std::move(item.second)});
+    }
+
+    iterator begin() {
+        if(const auto slot = NextPresentSlot(0); slot != iterator::kNoSlot)
+            return {this, slot, data_.begin()};
+        return {this, iterator::kNoSlot, data_.begin()};
+    }
+    iterator end() {
+        return {this, iterator::kNoSlot, data_.end()};
+    }
+    [[nodiscard]] iterator begin() const {
+        return const_cast<Closure*>(this)->begin();
+    }
+    [[nodiscard]] iterator end() const {
+        return const_cast<Closure*>(this)->end();
+    }
+
+    // Возвращает адрес значения занятого слота slot либо nullptr, если слот
+    // пуст. Индекс должен быть получен из формы таблицы
+    [[nodiscard]] ObjectHolder* SlotValue(std::size_t slot) {
+        return present_[slot] ? &slots_[slot] : nullptr;
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return slots_used_ + data_.size();
+    }
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+    void clear() {
+        for(std::size_t slot = 0; slot < slots_.size(); ++slot) {
+            if(present_[slot]) {
+                slots_[slot] = ObjectHolder();
+                present_[slot] = 0;
+            }
+        }
+        slots_used_ = 0;
+        data_.clear();
+    }
+
+private:
+    friend class iterator;
+    // Сборщик циклов обходит значения напрямую: итератор читает имена полей
+    // из Shape класса, а класс утёкшего экземпляра может быть уже разрушен
+    friend class CycleCollector;
+
+    // Возвращает индекс слота имени symbol либо iterator::kNoSlot
+    [[nodiscard]] std::size_t FindSlot(Symbol symbol) const {
+        if(shape_ != nullptr)
+            if(auto it = shape_->slots.find(symbol); it != shape_->slots.end())
+                return it->second;
+        return iterator::kNoSlot;
+    }
+
+    // Возвращает первый занятый слот, начиная с from, либо iterator::kNoSlot
+    [[nodiscard]] std::size_t NextPresentSlot(std::size_t from) const {
+        for(; from < present_.size(); ++from)
+            if(present_[from])
+                return from;
+        return iterator::kNoSlot;
+    }
+
+    const Shape* shape_ = nullptr;
+    std::vector<ObjectHolder> slots_;
+    std::vector<std::uint8_t> present_;
+    std::size_t slots_used_ = 0;
+    Storage data_;
+};
+
+// Возвращает Bool-значение из пула констант: True и False - вечные общие
+// объекты, возвращаемый ObjectHolder не владеет ими и копируется
+// без обращения к куче
+ObjectHolder MakeBool(bool value);
+
+// Возвращает число value: для малого диапазона [-128, 1023] - общий объект
+// из пула констант, вне диапазона - обычное встроенное значение
+ObjectHolder MakeNumber(int value);
+
+// Конкатенация строковых значений lhs и rhs. Буфер временного левого
+// операнда, которым держатель lhs владеет единолично, наращивается
+// на месте: цепочка a + b + c + ... не копирует накопленный префикс
+// заново, объём копирования линеен по длине результата
+ObjectHolder ConcatStrings(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+// Проверяет, содержится ли в object значение, приводимое к True
+// Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
+bool IsTrue(const ObjectHolder& object);
+
+/*
+ * Арена для узлов AST: память выделяется последовательно из крупных блоков,
+ * поэтому узлы программы лежат в памяти плотно, а освобождаются все блоки
+ * разом при разрушении арены. Пока арена активна (см. Arena::Scope),
+ * operator new всех Executable берёт память из неё
+ */
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Выделяет size байт с выравниванием align
+    void* Allocate(std::size_t size, std::size_t align);
+
+    // Делает арену активной на время жизни объекта Scope,
+    // по его разрушении восстанавливает предыдущую активную арену
+    class Scope {
+    public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena* previous_;
+    };
+
+    // Возвращает активную арену либо nullptr
+    static Arena* Current();
+
+private:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<unsigned char[]>> blocks_;
+    // Занято байт в последнем блоке; пока блоков нет - условно весь блок
+    std::size_t used_ = kBlockSize;
+};
+
+// Интерфейс для выполнения действий над объектами Mython
+class Executable {
+public:
+    virtual ~Executable() = default;
+    // Выполняет действие над объектами внутри closure, используя context
+    // Возвращает результирующее значение либо None
+    virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
+
+    // Узлы AST выделяются из активной арены, если она установлена.
+    // Память арены operator delete не освобождает - она вернётся вместе с ареной
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr) noexcept;
+
+    // Добавляет в fields имена полей, которые инструкция (включая вложенные)
+    // присваивает объекту self. Используется при построении формы полей класса
+    virtual void CollectSelfFields(std::vector<Symbol>& /*fields*/) const {
+    }
+
+    // Рекурсивно упрощает дочерние выражения узла (см. ast::Optimize)
+    virtual void FoldChildren() {
+    }
+
+    // Возвращает эквивалентный константный узел, если значение узла вычислимо
+    // на этапе разбора, либо nullptr, если узел не сворачивается
+    virtual std::unique_ptr<Executable> Fold() {
+        return nullptr;
+    }
+
+    // Эмитирует байткод узла в compiler и возвращает true.
+    // Возвращает false, если байткодового представления нет -
+    // тогда узел исполняется виртуальной машиной через Execute
+    virtual bool Compile(vm::Compiler& /*compiler*/) {
+        return false;
+    }
+
+    // Записывает двоичное представление узла и его потомков в out
+    // и возвращает true. Возвращает false, если узел не сериализуем.
+    // Восстановление - ast::StatementLoader
+    virtual bool Save(std::ostream& /*out*/) const {
+        return false;
+    }
+};
+
+// Метод класса
+class ClassInstance;
+class ArgsView;
+
+// Нативная реализация метода: вызывается с объектом self и фактическими
+// аргументами напрямую, без построения кадра с замыканием
+using NativeMethod = ObjectHolder (*)(ClassInstance& self, ArgsView args, Context& context);
+
+struct Method {
+    // Имя метода
+    std::string name;
+    // Имена формальных параметров метода
+    std::vector<std::string> formal_params;
+    // Тело метода; может быть пустым у метода с нативной реализацией
+    std::unique_ptr<Executable> body;
+    // Нативная реализация на C++; если задана, Call вызывает её напрямую
+    NativeMethod native = nullptr;
+    // Интернированные имена формальных параметров, заполняются конструктором Class
+    std::vector<Symbol> formal_param_syms{};
+};
+
+// Класс
+class Class : public Object {
+public:
+    // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
+    // Если parent равен nullptr, то создаётся базовый класс
+    explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
+
+    // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
+    [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+    [[nodiscard]] const Method* GetMethod(Symbol name) const;
+
+    // Возвращает имя класса
+    [[nodiscard]] const std::string& GetName() const;
+
+    // Возвращает родительский класс либо nullptr у базового класса
+    [[nodiscard]] const Class* GetParent() const {
+        return parent_;
+    }
+
+    // Возвращает собственные методы класса, без унаследованных
+    [[nodiscard]] const std::vector<Method>& GetMethods() const {
+        return methods_;
+    }
+
+    // Возвращает уникальный номер класса. Служит сторожем кешей вызовов:
+    // новый класс по старому адресу не пройдёт проверку по номеру
+    [[nodiscard]] std::uint64_t Id() const {
+        return id_;
+    }
+
+    // Возвращает форму полей экземпляров класса: слоты собственных
+    // и унаследованных полей, присваиваемых self в телах методов
+    [[nodiscard]] const Closure::Shape& GetFieldShape() const {
+        return field_shape_;
+    }
+
+    // Выводит в os строку "Class <имя класса>", например "Class cat"
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override;
+
+private:
+    std::string name_ = ""s;
+    std::vector<Method> methods_;
+    const Class* parent_ = nullptr;
+    std::uint64_t id_ = 0;
+    // Сплющенная таблица методов, включая унаследованные:
+    // поиск - одна проба независимо от глубины иерархии
+    std::unordered_map<Symbol, const Method*> method_table_;
+    Closure::Shape field_shape_;
+};
+
+/*
+ * Реестр нативных классов. Встраивающее приложение регистрирует классы
+ * со встроенными методами до разбора программ; парсер видит их наравне
+ * с классами, объявленными в исходном тексте, - программа может
+ * инстанцировать их и наследоваться от них. Зарегистрированные классы
+ * живут до конца процесса
+ */
+
+// Регистрирует класс cls, возвращает ссылку на зарегистрированный экземпляр
+const Class& RegisterNativeClass(Class cls);
+
+// Возвращает список зарегистрированных классов. Регистрация должна
+// завершиться до первого разбора программы
+const std::vector<const Class*>& NativeClasses();
+
+// Невладеющий диапазон фактических аргументов вызова - указатель и длина.
+// Вызывающая сторона размещает аргументы где угодно - в векторе, в массиве
+// на стеке, в списке в фигурных скобках - и передаёт их без копирования
+// и без выделения кучи
+class ArgsView {
+public:
+    ArgsView() = default;
+    ArgsView(const ObjectHolder* data, std::size_t size) : data_(data), size_(size) {}
+    ArgsView(const std::vector<ObjectHolder>& args) : data_(args.data()), size_(args.size()) {}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winit-list-lifetime"
+#endif
+    // Список аргументов живёт до конца полного выражения вызова - дольше,
+    // чем само представление, передаваемое параметром
+    ArgsView(std::initializer_list<ObjectHolder> args) : data_(args.begin()), size_(args.size()) {}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    [[nodiscard]] std::size_t size() const {
+        return size_;
+    }
+    const ObjectHolder& operator[](std::size_t index) const {
+        return data_[index];
+    }
+    [[nodiscard]] const ObjectHolder* begin() const {
+        return data_;
+    }
+    [[nodiscard]] const ObjectHolder* end() const {
+        return data_ + size_;
+    }
+
+private:
+    const ObjectHolder* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Экземпляр класса
+class ClassInstance : public Object {
+public:
+    explicit ClassInstance(const Class& cls);
+    ClassInstance(const ClassInstance& other);
+    ~ClassInstance() override;
+
+    /*
+     * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
+     * В противном случае в os выводится адрес объекта.
+     */
+    void Print(std::ostream& os, Context& context) override;
+
+    /*
+     * Вызывает у объекта метод method, передавая ему actual_args параметров.
+     * Параметр context задаёт контекст для выполнения метода.
+     * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
+     * runtime_error
+     */
+    ObjectHolder Call(const std::string& method, ArgsView actual_args, Context& context);
+
+    // Вызывает уже найденный метод method, минуя поиск по имени.
+    // method должен принадлежать классу объекта либо его родителям
+    ObjectHolder Call(const Method& method, ArgsView actual_args, Context& context);
+
+    // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
+    [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+
+    // Возвращает класс объекта
+    [[nodiscard]] const Class& GetClass() const {
+        return cls_;
+    }
+
+    // Возвращает ссылку на Closure, содержащий поля объекта
+    [[nodiscard]] Closure& Fields();
+    // Возвращает константную ссылку на Closure, содержащую поля объекта
+    [[nodiscard]] const Closure& Fields() const;
+
+private:
+    const Class& cls_;
+    Closure closure_;
+};
+
+/*
+ * Освобождает недостижимые циклы экземпляров классов, созданных текущим
+ * потоком. Счётчик ссылок не справляется с циклами - поле, ссылающееся на
+ * сам объект или на соседа, который ссылается обратно, удерживает граф
+ * навсегда. Вызывается встраивающим сервисом на границах запросов, между
+ * исполнениями программ. Возвращает число освобождённых экземпляров
+ */
+std::size_t CollectCycles();
+
+/*
+ * Счётчики памяти объектов Mython. Ведутся по потокам - там же, где живут
+ * и умирают сами объекты программы - и обновляются при создании и
+ * освобождении объекта в куче: пара инкрементов на аллокацию. Учитываются
+ * сами объекты и строковые буферы; служебные таблицы (хеш-таблицы полей,
+ * кеши узлов) не учитываются. Числа и логические значения размещаются
+ * внутри ObjectHolder и в пулах констант, кучу не трогают, поэтому их
+ * счётчики близки к нулю
+ */
+struct MemoryUsage {
+    // Число тегов Object::Type
+    static constexpr std::size_t kTypeCount = static_cast<std::size_t>(Object::Type::Other) + 1;
+
+    // Счётчики объектов одного типа
+    struct TypeUsage {
+        std::uint64_t live_objects = 0;
+        std::uint64_t live_bytes = 0;
+    };
+
+    // Возвращает счётчики объектов с тегом type
+    [[nodiscard]] const TypeUsage& ForType(Object::Type type) const {
+        return by_type[static_cast<std::size_t>(type)];
+    }
+
+    // Счётчики по тегам типов; индекс - значение Object::Type
+    std::array<TypeUsage, kTypeCount> by_type{};
+    // Суммарный объём живых объектов в байтах
+    std::uint64_t total_live_bytes = 0;
+    // Максимум total_live_bytes с последнего ResetPeakMemoryUsage
+    std::uint64_t peak_live_bytes = 0;
+};
+
+// Возвращает снимок счётчиков памяти текущего потока
+[[nodiscard]] MemoryUsage GetMemoryUsage();
+
+// Сбрасывает пиковую отметку текущего потока к текущему уровню.
+// Вызывается встраивающим сервисом на границах исполнений
+void ResetPeakMemoryUsage();
+
+// Устанавливает жёсткий предел суммарного объёма объектов текущего потока,
+// 0 снимает предел. Аллокация сверх предела выбрасывает runtime_error,
+// который можно перехватить и продолжить работу: счётчики остаются
+// согласованными, разогнавшаяся программа прерывается, не уронив процесс
+void SetMemoryLimit(std::uint64_t limit_bytes);
+
+/*
+ * Профилировщик исполнения: счётчики вызовов и суммарное время по методам.
+ * Включается контекстом - когда Context::GetProfiler() возвращает
+ * профилировщик, ClassInstance::Call записывает в него каждый вызов.
+ * В выключенном состоянии (по умолчанию) затраты сводятся к одной проверке
+ * указателя на вызов, поэтому хуки остаются в производственной сборке.
+ * Контекст принадлежит одному потоку, синхронизация не нужна
+ */
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Строка итогового отчёта
+    struct Entry {
+        // Имя вида Класс.метод
+        std::string name;
+        std::uint64_t calls;
+        Clock::duration total;
+    };
+
+    // Записывает вызов метода method класса cls, длившийся elapsed
+    void RecordCall(const Class& cls, const Method& method, Clock::duration elapsed);
+
+    // Возвращает собранные записи по убыванию суммарного времени
+    [[nodiscard]] std::vector<Entry> Report() const;
+
+    // Печатает отчёт о горячих точках в os
+    void Dump(std::ostream& os) const;
+
+private:
+    struct Stats {
+        std::string name;
+        std::uint64_t calls = 0;
+        Clock::duration total{};
+    };
+
+    std::unordered_map<const Method*, Stats> stats_;
+};
+
+/*
+ * Мономорфный кеш вызова метода: помнит последний увиденный класс
+ * и найденный в нём метод. Встраивается в место вызова (узел AST и т.п.),
+ * где класс объекта от исполнения к исполнению почти всегда один и тот же.
+ *
+ * Записи неизменяемы и публикуются атомарно, поэтому кеш безопасен при
+ * параллельном исполнении одной программы несколькими потоками. Вытесненные
+ * записи остаются в списке и освобождаются вместе с кешем: читатель другого
+ * потока может пользоваться ими сколь угодно долго
+ */
+class MethodCache {
+public:
+    MethodCache() = default;
+    MethodCache(const MethodCache&) = delete;
+    MethodCache& operator=(const MethodCache&) = delete;
+    ~MethodCache();
+
+private:
+    friend const Method* ResolveMethod(MethodCache& cache, const ClassInstance& object,
+                                       Symbol name, std::size_t argument_count);
+
+    struct Entry {
+        std::uint64_t cls_id;
+        const Method* method;
+        const Entry* next;
+    };
+
+    std::atomic<const Entry*> head_{nullptr};
+};
+
+// Ищет у класса объекта object метод name с argument_count параметрами,
+// сверяя класс с кешем cache по указателю. Возвращает nullptr, если метода
+// нет или число параметров не совпало
+const Method* ResolveMethod(MethodCache& cache, const ClassInstance& object, Symbol name,
+                            std::size_t argument_count);
+
+/*
+ * Мономорфный кеш доступа к полю: помнит последний увиденный класс и индекс
+ * слота поля в его форме. Повторный шаг цепочки a.b.c находит значение
+ * по индексу, без хеширования имени. Записи устроены так же, как
+ * в MethodCache, и безопасны при параллельном исполнении
+ */
+class FieldCache {
+public:
+    FieldCache() = default;
+    FieldCache(const FieldCache&) = delete;
+    FieldCache& operator=(const FieldCache&) = delete;
+    ~FieldCache();
+
+private:
+    friend ObjectHolder* ResolveField(FieldCache& cache, ClassInstance& object, Symbol name);
+
+    // Значение slot для имени, не входящего в форму класса
+    static constexpr std::size_t kNoSlot = std::numeric_limits<std::size_t>::max();
+
+    struct Entry {
+        std::uint64_t cls_id;
+        std::size_t slot;
+        const Entry* next;
+    };
+
+    std::atomic<const Entry*> head_{nullptr};
+};
+
+// Ищет поле name объекта object, сверяя класс объекта с кешем cache.
+// Возвращает адрес значения поля либо nullptr, если поле не установлено
+ObjectHolder* ResolveField(FieldCache& cache, ClassInstance& object, Symbol name);
+
+namespace detail {
+
+template <>
+struct ObjectTypeTag<Number> {
+    static constexpr Object::Type value = Object::Type::Number;
+};
+
+template <>
+struct ObjectTypeTag<String> {
+    static constexpr Object::Type value = Object::Type::String;
+};
+
+template <>
+struct ObjectTypeTag<Bool> {
+    static constexpr Object::Type value = Object::Type::Bool;
+};
+
+template <>
+struct ObjectTypeTag<Class> {
+    static constexpr Object::Type value = Object::Type::Class;
+};
+
+template <>
+struct ObjectTypeTag<ClassInstance> {
+    static constexpr Object::Type value = Object::Type::ClassInstance;
+};
+
+}  // namespace detail
+
+/*
+ * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
+ * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
+ * приведённый к типу Bool. Если lhs и rhs имеют значение None, функция возвращает true.
+ * В остальных случаях функция выбрасывает исключение runtime_error.
+ *
+ * Параметр context задаёт контекст для выполнения метода __eq__
+ */
+bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+/*
+ * Если lhs и rhs - числа, строки или значения bool, функция возвращает результат их сравнения
+ * оператором <.
+ * Если lhs - объект с методом __lt__, возвращает результат вызова lhs.__lt__(rhs),
+ * приведённый к типу bool. В остальных случаях функция выбрасывает исключение runtime_error.
+ *
+ * Параметр context задаёт контекст для выполнения метода __lt__
+ */
+bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает значение, противоположное Equal(lhs, rhs, context)
+bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает значение lhs>rhs, используя функции Equal и Less
+bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает значение lhs<=rhs, используя функции Equal и Less
+bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает значение, противоположное Less(lhs, rhs, context)
+bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+/*
+ * Возвращает сумму lhs и rhs. Поддерживается сложение:
+ *  число + число, строка + строка,
+ *  объект1 + объект2, если объект1 - экземпляр класса с методом __add__(rhs).
+ * В остальных случаях выбрасывается runtime_error
+ */
+ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает разность чисел lhs и rhs, иначе выбрасывает runtime_error
+ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает произведение чисел lhs и rhs, иначе выбрасывает runtime_error
+ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+// Возвращает частное чисел lhs и rhs. Если rhs равен 0 или аргументы - не числа,
+// выбрасывается runtime_error
+ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+// Контекст-заглушка, применяется в тестах.
+// В этом контексте весь вывод перенаправляется в строковый поток вывода output
+struct DummyContext : Context {
+    std::ostream& GetOutputStream() override {
+        return output;
+    }
+
+    std::ostringstream output;
+};
+
+// Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
+class SimpleContext : public runtime::Context {
+public:
+    explicit SimpleContext(std::ostream& output)
+        : output_(output) {
+    }
+
+    std::ostream& GetOutputStream() override {
+        return output_;
+    }
+
+private:
+    std::ostream& output_;
+};
+
+// Контекст с собственным буфером вывода: print пишет в буфер, который
+// сбрасывается в поток output крупными блоками. Прямое обращение к потоку
+// через GetOutputStream сбрасывает буфер, сохраняя порядок вывода
+class BufferedContext : public Context {
+public:
+    explicit BufferedContext(std::ostream& output)
+        : output_(output), buffer_(output) {
+    }
+
+    std::ostream& GetOutputStream() override {
+        buffer_.Flush();
+        return output_;
+    }
+
+    OutputBuffer* GetOutputBuffer() override {
+        return &buffer_;
+    }
+
+private:
+    std::ostream& output_;
+    OutputBuffer buffer_;
+};
+
+// Контекст с включённым профилировщиком поверх буферизованного вывода
+class ProfilingContext : public BufferedContext {
+public:
+    using BufferedContext::BufferedContext;
+
+    Profiler* GetProfiler() override {
+        return &profiler_;
+    }
+
+private:
+    Profiler profiler_;
+};
+
+}  // namespace runtime
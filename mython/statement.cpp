@@ -1,349 +1,1338 @@
-#include "statement.h"
-
-#include <iostream>
-#include <sstream>
-
-using namespace std;
-
-namespace ast {
-
-using runtime::Closure;
-using runtime::Context;
-using runtime::ObjectHolder;
-
-namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
-}  // namespace
-
-ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
-    return closure[name_] = value_->Execute(closure, context);
-}
-
-Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
-    : name_(std::move(var)), value_(std::move(rv)) {}
-
-VariableValue::VariableValue(const std::string& var_name)
-    : var_name_(std::move(var_name)) {}
-
-VariableValue::VariableValue(std::vector<std::string> dotted_ids)
-    : dotted_ids_(std::move(dotted_ids)) {}
-
-ObjectHolder VariableValue::Execute(Closure& closure, [[maybe_unused]] Context& context) {
-    if(var_name_ != ""s) {
-        if(auto it = closure.find(var_name_); it != closure.end())
-            return it->second;
-    } else
-    if(dotted_ids_.size() > 0) {
-        ObjectHolder result;
-        Closure* closure_ = &closure;
-        for(const auto& id : dotted_ids_) {
-            if(auto it = closure_->find(id); it != closure_->end()) {
-                result = it->second;
-                auto obj = result.TryAs<runtime::ClassInstance>();
-                if(obj != nullptr)
-                    closure_ = &obj->Fields();
-            } else
-                throw runtime_error("VariableValue(dotted.?)"s);
-        }
-        return result;
-    }
-
-    throw runtime_error("VariableValue(?)"s);
-}
-
-unique_ptr<Print> Print::Variable(const std::string& name) {
-    return make_unique<Print>(make_unique<VariableValue>(name));
-}
-
-Print::Print(unique_ptr<Statement> argument) {
-    args_.push_back(std::move(argument));
-}
-
-Print::Print(vector<unique_ptr<Statement>> args) : args_(std::move(args)) {}
-
-ObjectHolder Print::Execute(Closure& closure, Context& context) {
-    bool first = true;
-    for(const auto& arg : args_) {
-        if(first) first = false;
-        else context.GetOutputStream() << " "s;
-
-        auto obj_hold = arg->Execute(closure, context);
-        auto obj = obj_hold.Get();
-        if(obj == nullptr) {
-            context.GetOutputStream() << "None"s;
-        } else {
-            obj->Print(context.GetOutputStream(), context);
-        }
-    }
-    context.GetOutputStream() << "\n"s;
-    return {};
-}
-
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
-                       std::vector<std::unique_ptr<Statement>> args)
-    : object_(std::move(object)), method_(std::move(method)), args_(std::move(args)) {}
-
-ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
-    auto obj = object_->Execute(closure, context).TryAs<runtime::ClassInstance>();
-    if(obj == nullptr)
-        throw runtime_error("MethodCall(? object,,)"s);
-
-    if(!obj->HasMethod(method_, args_.size()))
-        throw runtime_error("MethodCall(,? method,)"s);
-
-    std::vector<ObjectHolder> args;
-    for (auto& arg : args_)
-        args.push_back(arg.get()->Execute(closure, context));
-
-    return obj->Call(method_, args, context);
-}
-
-ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-
-    auto obj_hold = argument_->Execute(closure, context);
-    auto obj = obj_hold.Get();
-
-    if(obj != nullptr) {
-        std::stringstream s;
-        obj->Print(s, context);
-        return ObjectHolder::Own(runtime::String{s.str()});
-    } else {
-        return ObjectHolder::Own(runtime::String{"None"s});
-    }
-
-    return {};
-}
-
-ObjectHolder Add::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto rhs_obj_hold = rhs_->Execute(closure, context);
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::Number>();
-        if(lhs_obj != nullptr) {
-            auto rhs_obj = rhs_obj_hold.TryAs<runtime::Number>();
-            if(rhs_obj != nullptr) {
-                return ObjectHolder::Own(runtime::Number{lhs_obj->GetValue() +
-                                                         rhs_obj->GetValue()});
-            } else {
-                throw runtime_error("Add(Number, ?)"s);
-            }
-        }
-    }
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::String>();
-        if(lhs_obj != nullptr) {
-            auto rhs_obj = rhs_obj_hold.TryAs<runtime::String>();
-            if(rhs_obj != nullptr) {
-                return ObjectHolder::Own(runtime::String{lhs_obj->GetValue() +
-                                                         rhs_obj->GetValue()});
-            } else {
-                throw runtime_error("Add(String, ?)"s);
-            }
-        }
-    }
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::ClassInstance>();
-        if(lhs_obj != nullptr) {
-            if(lhs_obj->HasMethod("__add__"s, 1)) {
-                return lhs_obj->Call("__add__"s, {std::move(rhs_obj_hold)}, context);
-            }
-        }
-    }
-    throw runtime_error("Add(?, ?)"s);
-}
-
-ObjectHolder Sub::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto rhs_obj_hold = rhs_->Execute(closure, context);
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::Number>();
-        if(lhs_obj != nullptr) {
-            auto rhs_obj = rhs_obj_hold.TryAs<runtime::Number>();
-            if(rhs_obj != nullptr) {
-                return ObjectHolder::Own(runtime::Number{lhs_obj->GetValue() -
-                                                         rhs_obj->GetValue()});
-            } else {
-                throw runtime_error("Sub(Number, ?)"s);
-            }
-        }
-    }
-    throw runtime_error("Sub(?, ?)"s);
-}
-
-ObjectHolder Mult::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto rhs_obj_hold = rhs_->Execute(closure, context);
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::Number>();
-        if(lhs_obj != nullptr) {
-            auto rhs_obj = rhs_obj_hold.TryAs<runtime::Number>();
-            if(rhs_obj != nullptr) {
-                return ObjectHolder::Own(runtime::Number{lhs_obj->GetValue() *
-                                                         rhs_obj->GetValue()});
-            } else {
-                throw runtime_error("Mult(Number, ?)"s);
-            }
-        }
-    }
-    throw runtime_error("Mult(?, ?)"s);
-}
-
-ObjectHolder Div::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto rhs_obj_hold = rhs_->Execute(closure, context);
-    {
-        auto lhs_obj = lhs_obj_hold.TryAs<runtime::Number>();
-        if(lhs_obj != nullptr) {
-            auto rhs_obj = rhs_obj_hold.TryAs<runtime::Number>();
-            if(rhs_obj != nullptr) {
-                if(rhs_obj->GetValue() == 0)
-                    throw runtime_error("Div(Number, 0): divide by zero"s);
-
-                return ObjectHolder::Own(runtime::Number{lhs_obj->GetValue() /
-                                                         rhs_obj->GetValue()});
-            } else {
-                throw runtime_error("Div(Number, ?)"s);
-            }
-        }
-    }
-    throw runtime_error("Div(?, ?)"s);
-}
-
-ObjectHolder Compound::Execute(Closure& closure, Context& context) {
-    for(const auto& stmt : stmts_)
-        stmt->Execute(closure, context);
-    return {};
-}
-
-ObjectHolder Return::Execute(Closure& closure, Context& context) {
-    closure["return"s] = statement_->Execute(closure, context);
-    throw runtime_error("return"s);
-}
-
-ClassDefinition::ClassDefinition(ObjectHolder cls) : cls_(std::move(cls)) {}
-
-ObjectHolder ClassDefinition::Execute(Closure& closure, Context& context) {
-    auto obj = cls_.TryAs<runtime::Class>();
-    return closure[obj->GetName()] =
-            make_unique<NewInstance>(*obj)->Execute(closure, context);
-}
-
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
-                                 std::unique_ptr<Statement> rv)
-    : object_(std::move(object)), name_(std::move(field_name)), value_(std::move(rv)) {}
-
-ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
-    const auto obj = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
-
-    if(obj == nullptr)
-        throw std::runtime_error("FieldAssignment: haven't object"s);
-
-    return obj->Fields()[name_] = value_->Execute(closure, context);
-}
-
-IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
-               std::unique_ptr<Statement> else_body)
-    : condition_(std::move(condition)), if_body_(std::move(if_body)),
-      else_body_(std::move(else_body)) {}
-
-ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
-    auto cond = condition_->Execute(closure, context).TryAs<runtime::Bool>();
-    if(cond->GetValue())
-        return if_body_->Execute(closure, context);
-    else if(else_body_ != nullptr)
-        return else_body_->Execute(closure, context);
-    else
-        return {};
-}
-
-ObjectHolder Or::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto lhs_obj = lhs_obj_hold.TryAs<runtime::Bool>();
-    if(lhs_obj != nullptr) {
-        if(lhs_obj->GetValue()) {
-            return lhs_obj_hold;
-        }
-
-        auto rhs_obj_hold = rhs_->Execute(closure, context);
-        auto rhs_obj = rhs_obj_hold.TryAs<runtime::Bool>();
-        if(rhs_obj != nullptr) {
-            return rhs_obj_hold;
-        }
-    }
-    throw runtime_error("Or(?, ?)"s);;
-}
-
-ObjectHolder And::Execute(Closure& closure, Context& context) {
-    auto lhs_obj_hold = lhs_->Execute(closure, context);
-    auto lhs_obj = lhs_obj_hold.TryAs<runtime::Bool>();
-    if(lhs_obj != nullptr) {
-        if(!lhs_obj->GetValue()) {
-            return lhs_obj_hold;
-        }
-
-        auto rhs_obj_hold = rhs_->Execute(closure, context);
-        auto rhs_obj = rhs_obj_hold.TryAs<runtime::Bool>();
-        if(rhs_obj != nullptr) {
-            return rhs_obj_hold;
-        }
-    }
-    throw runtime_error("And(?, ?)"s);;
-}
-
-ObjectHolder Not::Execute(Closure& closure, Context& context) {
-    auto arg = argument_->Execute(closure, context).TryAs<runtime::Bool>();
-    if(arg != nullptr) {
-        return ObjectHolder::Own(runtime::Bool{arg->GetValue() ? false : true});
-    }
-    throw runtime_error("Not(?)"s);;
-}
-
-Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
-    : BinaryOperation(std::move(lhs), std::move(rhs)), cmp_(std::move(cmp)) {}
-
-ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-    auto lhs = lhs_->Execute(closure, context);
-    auto rhs = rhs_->Execute(closure, context);
-    return ObjectHolder::Own(runtime::Bool(cmp_(lhs, rhs, context)));
-}
-
-NewInstance::NewInstance(const runtime::Class& cls,
-                         std::vector<std::unique_ptr<Statement>> args)
-    : class_(cls), args_(std::move(args)) {}
-
-NewInstance::NewInstance(const runtime::Class& cls) : class_(cls) {}
-
-ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-    auto result = ObjectHolder().Own(runtime::ClassInstance(class_));
-
-    auto new_obj = result.TryAs<runtime::ClassInstance>();
-    if (new_obj != nullptr && new_obj->HasMethod(INIT_METHOD, args_.size())) {
-
-        std::vector<ObjectHolder> args;
-        for (auto& arg : args_)
-            args.push_back(arg.get()->Execute(closure, context));
-
-        new_obj->Call(INIT_METHOD, args, context);
-    }
-
-    return result;
-}
-
-MethodBody::MethodBody(std::unique_ptr<Statement>&& body)
-    : body_(std::move(body)) {}
-
-ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
-    try {
-        body_->Execute(closure, context);
-        return {};
-    }  catch (const std::runtime_error& e) {
-        if(e.what() == "return"s) {
-            if(auto it = closure.find("return"s); it != closure.end())
-                return it->second;
-        }
-        return {};
-    }
-}
-
-}  // namespace ast
+#include "statement.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::Closure;
+using runtime::Context;
+using runtime::ObjectHolder;
+
+namespace {
+const string ADD_METHOD = "__add__"s;
+const string INIT_METHOD = "__init__"s;
+
+// Сигнал выхода из метода: Return поднимает флаг и сохраняет значение,
+// объемлющие инструкции прекращают исполнение, MethodBody снимает флаг.
+// Обходится без раскрутки исключения и вставки в хеш-таблицу кадра
+thread_local bool return_pending = false;
+thread_local ObjectHolder return_value;
+
+// Режим владеющих констант текущего потока - см. SetOwnedConstants
+thread_local bool owned_constants = false;
+
+// Буфер фактических аргументов вызова: типичные арности размещаются
+// на стеке, куча используется только для длинных списков аргументов
+class ArgsBuffer {
+public:
+    explicit ArgsBuffer(size_t size) : size_(size) {
+        if(size > kInline) {
+            heap_.resize(size);
+            data_ = heap_.data();
+        }
+    }
+
+    ObjectHolder& operator[](size_t index) {
+        return data_[index];
+    }
+    operator runtime::ArgsView() const {
+        return {data_, size_};
+    }
+
+private:
+    static constexpr size_t kInline = 4;
+
+    size_t size_;
+    ObjectHolder inline_[kInline];
+    std::vector<ObjectHolder> heap_;
+    ObjectHolder* data_ = inline_;
+};
+}  // namespace
+
+void SetOwnedConstants(bool enabled) {
+    owned_constants = enabled;
+}
+
+void ResetPendingReturn() {
+    return_pending = false;
+    return_value = ObjectHolder();
+}
+
+template <>
+ObjectHolder ValueStatement<runtime::Number>::Execute(Closure& /*closure*/,
+                                                      Context& /*context*/) {
+    return runtime::MakeNumber(value_.GetValue());
+}
+
+template <>
+ObjectHolder ValueStatement<runtime::Bool>::Execute(Closure& /*closure*/, Context& /*context*/) {
+    return runtime::MakeBool(value_.GetValue());
+}
+
+template <>
+ObjectHolder ValueStatement<runtime::String>::Execute(Closure& /*closure*/,
+                                                      Context& /*context*/) {
+    if(owned_constants)
+        return ObjectHolder::Own(runtime::String(value_));
+    return ObjectHolder::Share(value_);
+}
+
+ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
+    return closure[name_] = value_->Execute(closure, context);
+}
+
+Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
+    : name_(runtime::Intern(var)), value_(std::move(rv)) {}
+
+VariableValue::VariableValue(const std::string& var_name)
+    : var_name_(runtime::Intern(var_name)) {}
+
+VariableValue::VariableValue(std::vector<std::string> dotted_ids) {
+    // Цепочка из одного имени - обычная переменная: одиночный путь быстрее
+    // и компилируется в байткод без фолбэка на обходчик дерева
+    if(dotted_ids.size() == 1) {
+        var_name_ = runtime::Intern(dotted_ids.front());
+        return;
+    }
+    dotted_ids_.reserve(dotted_ids.size());
+    for(const auto& id : dotted_ids)
+        dotted_ids_.push_back(runtime::Intern(id));
+    step_caches_ = std::make_unique<runtime::FieldCache[]>(dotted_ids_.size() - 1);
+}
+
+ObjectHolder VariableValue::Execute(Closure& closure, [[maybe_unused]] Context& context) {
+    if(var_name_ != runtime::kNoSymbol) {
+        if(auto it = closure.find(var_name_); it != closure.end())
+            return it->second;
+    } else
+    if(dotted_ids_.size() > 0) {
+        ObjectHolder result;
+        Closure* closure_ = &closure;
+        runtime::ClassInstance* receiver = nullptr;
+        for(size_t step = 0; step < dotted_ids_.size(); ++step) {
+            const auto id = dotted_ids_[step];
+            if(receiver != nullptr) {
+                // Шаг доступа к полю: индекс слота берётся из кеша шага,
+                // без хеширования имени в форме класса
+                ObjectHolder* field = runtime::ResolveField(step_caches_[step - 1], *receiver, id);
+                if(field == nullptr)
+                    throw runtime_error("VariableValue(dotted.?)"s);
+                result = *field;
+            } else if(auto it = closure_->find(id); it != closure_->end()) {
+                result = it->second;
+            } else
+                throw runtime_error("VariableValue(dotted.?)"s);
+
+            auto obj = result.TryAs<runtime::ClassInstance>();
+            if(obj != nullptr) {
+                receiver = obj;
+                closure_ = &obj->Fields();
+            }
+        }
+        return result;
+    }
+
+    throw runtime_error("VariableValue(?)"s);
+}
+
+unique_ptr<Print> Print::Variable(const std::string& name) {
+    return make_unique<Print>(make_unique<VariableValue>(name));
+}
+
+Print::Print(unique_ptr<Statement> argument) {
+    args_.push_back(std::move(argument));
+}
+
+Print::Print(vector<unique_ptr<Statement>> args) : args_(std::move(args)) {}
+
+ObjectHolder Print::Execute(Closure& closure, Context& context) {
+    if(auto* buffer = context.GetOutputBuffer(); buffer != nullptr)
+        return ExecuteBuffered(*buffer, closure, context);
+
+    bool first = true;
+    for(const auto& arg : args_) {
+        if(first) first = false;
+        else context.GetOutputStream() << " "s;
+
+        auto obj_hold = arg->Execute(closure, context);
+        auto obj = obj_hold.Get();
+        if(obj == nullptr) {
+            context.GetOutputStream() << "None"s;
+        } else {
+            obj->Print(context.GetOutputStream(), context);
+        }
+    }
+    context.GetOutputStream() << "\n"s;
+    return {};
+}
+
+ObjectHolder Print::ExecuteBuffered(runtime::OutputBuffer& buffer, Closure& closure,
+                                    Context& context) {
+    bool first = true;
+    for(const auto& arg : args_) {
+        if(first) first = false;
+        else buffer.Append(' ');
+
+        auto obj_hold = arg->Execute(closure, context);
+        auto obj = obj_hold.Get();
+        if(obj == nullptr) {
+            buffer.Append("None"sv);
+            continue;
+        }
+        switch(obj->GetType()) {
+        case runtime::Object::Type::Number:
+            buffer.AppendNumber(static_cast<const runtime::Number&>(*obj).GetValue());
+            break;
+        case runtime::Object::Type::String:
+            buffer.Append(static_cast<const runtime::String&>(*obj).GetValue());
+            break;
+        case runtime::Object::Type::Bool:
+            buffer.Append(static_cast<const runtime::Bool&>(*obj).GetValue() ? "True"sv
+                                                                             : "False"sv);
+            break;
+        default:
+            // Пользовательская печать идёт через поток;
+            // GetOutputStream сбрасывает буфер, сохраняя порядок вывода
+            obj->Print(context.GetOutputStream(), context);
+            break;
+        }
+    }
+    buffer.Append('\n');
+    return {};
+}
+
+MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+                       std::vector<std::unique_ptr<Statement>> args)
+    : object_(std::move(object)), method_(runtime::Intern(method)), args_(std::move(args)) {}
+
+ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
+    auto obj_hold = object_->Execute(closure, context);
+    auto obj = obj_hold.TryAs<runtime::ClassInstance>();
+    if(obj == nullptr)
+        throw runtime_error("MethodCall(? object,,)"s);
+
+    const auto* method = runtime::ResolveMethod(cache_, *obj, method_, args_.size());
+    if(method == nullptr)
+        throw runtime_error("MethodCall(,? method,)"s);
+
+    ArgsBuffer args(args_.size());
+    for (size_t i = 0; i < args_.size(); ++i)
+        args[i] = args_[i]->Execute(closure, context);
+
+    return obj->Call(*method, args, context);
+}
+
+ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
+
+    auto obj_hold = argument_->Execute(closure, context);
+    auto obj = obj_hold.Get();
+
+    if(obj == nullptr)
+        return ObjectHolder::Own(runtime::String{"None"s});
+
+    // Простые значения минуют ostringstream: строка разделяется как есть,
+    // число печатается в буфер на стеке
+    switch(obj->GetType()) {
+    case runtime::Object::Type::String:
+        // Владеющий держатель разделяется как есть; заимствованная строка
+        // (литерал из дерева программы) копируется - результат str()
+        // не должен зависеть от времени жизни дерева
+        if(obj_hold.IsOwning())
+            return obj_hold;
+        return ObjectHolder::Own(
+            runtime::String{static_cast<const runtime::String&>(*obj).GetValue()});
+    case runtime::Object::Type::Number: {
+        char digits[16];
+        auto [last, ec] = std::to_chars(std::begin(digits), std::end(digits),
+                                        static_cast<const runtime::Number&>(*obj).GetValue());
+        (void)ec;
+        return ObjectHolder::Own(runtime::String{std::string(digits, last)});
+    }
+    case runtime::Object::Type::Bool:
+        return ObjectHolder::Own(
+            runtime::String{static_cast<const runtime::Bool&>(*obj).GetValue() ? "True"s : "False"s});
+    default: {
+        std::stringstream s;
+        obj->Print(s, context);
+        return ObjectHolder::Own(runtime::String{s.str()});
+    }
+    }
+}
+
+BinaryOperation::Feedback BinaryOperation::ObserveTypes(const ObjectHolder& lhs,
+                                                        const ObjectHolder& rhs) {
+    if(lhs.TryAs<runtime::Number>() != nullptr && rhs.TryAs<runtime::Number>() != nullptr)
+        return Feedback::Number;
+    if(lhs.TryAs<runtime::String>() != nullptr && rhs.TryAs<runtime::String>() != nullptr)
+        return Feedback::String;
+    return Feedback::Generic;
+}
+
+ObjectHolder Add::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto rhs_obj_hold = rhs_->Execute(closure, context);
+    // Специализированные пути по собранной обратной связи о типах:
+    // проверка-страж плюс прямое вычисление, без каскада проб в runtime::Add
+    const auto feedback = feedback_.load(std::memory_order_relaxed);
+    if(feedback == Feedback::Number) {
+        auto lhs_num = lhs_obj_hold.TryAs<runtime::Number>();
+        auto rhs_num = rhs_obj_hold.TryAs<runtime::Number>();
+        if(lhs_num != nullptr && rhs_num != nullptr)
+            return runtime::MakeNumber(lhs_num->GetValue() + rhs_num->GetValue());
+        feedback_.store(Feedback::Generic, std::memory_order_relaxed);
+    } else if(feedback == Feedback::String) {
+        auto lhs_str = lhs_obj_hold.TryAs<runtime::String>();
+        auto rhs_str = rhs_obj_hold.TryAs<runtime::String>();
+        if(lhs_str != nullptr && rhs_str != nullptr)
+            return runtime::ConcatStrings(lhs_obj_hold, rhs_obj_hold);
+        feedback_.store(Feedback::Generic, std::memory_order_relaxed);
+    } else if(feedback == Feedback::None) {
+        feedback_.store(ObserveTypes(lhs_obj_hold, rhs_obj_hold), std::memory_order_relaxed);
+    }
+    return runtime::Add(lhs_obj_hold, rhs_obj_hold, context);
+}
+
+ObjectHolder Sub::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto rhs_obj_hold = rhs_->Execute(closure, context);
+    const auto feedback = feedback_.load(std::memory_order_relaxed);
+    if(feedback == Feedback::Number) {
+        auto lhs_num = lhs_obj_hold.TryAs<runtime::Number>();
+        auto rhs_num = rhs_obj_hold.TryAs<runtime::Number>();
+        if(lhs_num != nullptr && rhs_num != nullptr)
+            return runtime::MakeNumber(lhs_num->GetValue() - rhs_num->GetValue());
+        feedback_.store(Feedback::Generic, std::memory_order_relaxed);
+    } else if(feedback == Feedback::None) {
+        feedback_.store(ObserveTypes(lhs_obj_hold, rhs_obj_hold), std::memory_order_relaxed);
+    }
+    return runtime::Sub(lhs_obj_hold, rhs_obj_hold, context);
+}
+
+ObjectHolder Mult::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto rhs_obj_hold = rhs_->Execute(closure, context);
+    const auto feedback = feedback_.load(std::memory_order_relaxed);
+    if(feedback == Feedback::Number) {
+        auto lhs_num = lhs_obj_hold.TryAs<runtime::Number>();
+        auto rhs_num = rhs_obj_hold.TryAs<runtime::Number>();
+        if(lhs_num != nullptr && rhs_num != nullptr)
+            return runtime::MakeNumber(lhs_num->GetValue() * rhs_num->GetValue());
+        feedback_.store(Feedback::Generic, std::memory_order_relaxed);
+    } else if(feedback == Feedback::None) {
+        feedback_.store(ObserveTypes(lhs_obj_hold, rhs_obj_hold), std::memory_order_relaxed);
+    }
+    return runtime::Mult(lhs_obj_hold, rhs_obj_hold, context);
+}
+
+ObjectHolder Div::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto rhs_obj_hold = rhs_->Execute(closure, context);
+    // Деление на ноль уходит на общий путь, где выбрасывается исключение
+    const auto feedback = feedback_.load(std::memory_order_relaxed);
+    if(feedback == Feedback::Number) {
+        auto lhs_num = lhs_obj_hold.TryAs<runtime::Number>();
+        auto rhs_num = rhs_obj_hold.TryAs<runtime::Number>();
+        if(lhs_num != nullptr && rhs_num != nullptr && rhs_num->GetValue() != 0)
+            return runtime::MakeNumber(lhs_num->GetValue() / rhs_num->GetValue());
+        feedback_.store(Feedback::Generic, std::memory_order_relaxed);
+    } else if(feedback == Feedback::None) {
+        feedback_.store(ObserveTypes(lhs_obj_hold, rhs_obj_hold), std::memory_order_relaxed);
+    }
+    return runtime::Div(lhs_obj_hold, rhs_obj_hold, context);
+}
+
+ObjectHolder Compound::Execute(Closure& closure, Context& context) {
+    for(const auto& stmt : stmts_) {
+        stmt->Execute(closure, context);
+        if(return_pending)
+            break;
+    }
+    return {};
+}
+
+void Compound::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    for(const auto& stmt : stmts_)
+        stmt->CollectSelfFields(fields);
+}
+
+ObjectHolder Return::Execute(Closure& closure, Context& context) {
+    return_value = statement_->Execute(closure, context);
+    return_pending = true;
+    return {};
+}
+
+ClassDefinition::ClassDefinition(ObjectHolder cls) : cls_(std::move(cls)) {}
+
+ObjectHolder ClassDefinition::Execute(Closure& closure, Context& context) {
+    auto obj = cls_.TryAs<runtime::Class>();
+    return closure[obj->GetName()] =
+            make_unique<NewInstance>(*obj)->Execute(closure, context);
+}
+
+FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+                                 std::unique_ptr<Statement> rv)
+    : object_(std::move(object)), name_(runtime::Intern(field_name)), value_(std::move(rv)) {}
+
+void FieldAssignment::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    static const runtime::Symbol self_sym = runtime::Intern("self"s);
+    if(object_.IsName(self_sym))
+        fields.push_back(name_);
+}
+
+ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
+    const auto obj = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
+
+    if(obj == nullptr)
+        throw std::runtime_error("FieldAssignment: haven't object"s);
+
+    return obj->Fields()[name_] = value_->Execute(closure, context);
+}
+
+IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
+               std::unique_ptr<Statement> else_body)
+    : condition_(std::move(condition)), if_body_(std::move(if_body)),
+      else_body_(std::move(else_body)) {}
+
+void IfElse::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    if_body_->CollectSelfFields(fields);
+    if(else_body_ != nullptr)
+        else_body_->CollectSelfFields(fields);
+}
+
+ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
+    auto cond_obj_hold = condition_->Execute(closure, context);
+    auto cond = cond_obj_hold.TryAs<runtime::Bool>();
+    if(cond->GetValue())
+        return if_body_->Execute(closure, context);
+    else if(else_body_ != nullptr)
+        return else_body_->Execute(closure, context);
+    else
+        return {};
+}
+
+While::While(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> body)
+    : condition_(std::move(condition)), body_(std::move(body)) {}
+
+void While::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    body_->CollectSelfFields(fields);
+}
+
+ObjectHolder While::Execute(Closure& closure, Context& context) {
+    for(;;) {
+        auto cond_obj_hold = condition_->Execute(closure, context);
+        auto cond = cond_obj_hold.TryAs<runtime::Bool>();
+        if(!cond->GetValue())
+            break;
+        body_->Execute(closure, context);
+        // return внутри тела завершает и цикл, и объемлющий метод
+        if(return_pending)
+            break;
+    }
+    return {};
+}
+
+ForRange::ForRange(std::string var_name, std::unique_ptr<Statement> from,
+                   std::unique_ptr<Statement> to, std::unique_ptr<Statement> body)
+    : var_(runtime::Intern(var_name)), from_(std::move(from)), to_(std::move(to)),
+      body_(std::move(body)) {}
+
+void ForRange::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    body_->CollectSelfFields(fields);
+}
+
+ObjectHolder ForRange::Execute(Closure& closure, Context& context) {
+    // Границы вычисляются один раз, до входа в цикл
+    int from = 0;
+    if(from_ != nullptr) {
+        auto from_obj_hold = from_->Execute(closure, context);
+        auto from_obj = from_obj_hold.TryAs<runtime::Number>();
+        if(from_obj == nullptr)
+            throw runtime_error("ForRange(? from,)"s);
+        from = from_obj->GetValue();
+    }
+    auto to_obj_hold = to_->Execute(closure, context);
+    auto to_obj = to_obj_hold.TryAs<runtime::Number>();
+    if(to_obj == nullptr)
+        throw runtime_error("ForRange(,? to)"s);
+    const int to = to_obj->GetValue();
+
+    for(int value = from; value < to; ++value) {
+        closure[var_] = runtime::MakeNumber(value);
+        body_->Execute(closure, context);
+        if(return_pending)
+            break;
+    }
+    return {};
+}
+
+ObjectHolder Or::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto lhs_obj = lhs_obj_hold.TryAs<runtime::Bool>();
+    if(lhs_obj != nullptr) {
+        if(lhs_obj->GetValue()) {
+            return lhs_obj_hold;
+        }
+
+        auto rhs_obj_hold = rhs_->Execute(closure, context);
+        auto rhs_obj = rhs_obj_hold.TryAs<runtime::Bool>();
+        if(rhs_obj != nullptr) {
+            return rhs_obj_hold;
+        }
+    }
+    throw runtime_error("Or(?, ?)"s);;
+}
+
+ObjectHolder And::Execute(Closure& closure, Context& context) {
+    auto lhs_obj_hold = lhs_->Execute(closure, context);
+    auto lhs_obj = lhs_obj_hold.TryAs<runtime::Bool>();
+    if(lhs_obj != nullptr) {
+        if(!lhs_obj->GetValue()) {
+            return lhs_obj_hold;
+        }
+
+        auto rhs_obj_hold = rhs_->Execute(closure, context);
+        auto rhs_obj = rhs_obj_hold.TryAs<runtime::Bool>();
+        if(rhs_obj != nullptr) {
+            return rhs_obj_hold;
+        }
+    }
+    throw runtime_error("And(?, ?)"s);;
+}
+
+ObjectHolder Not::Execute(Closure& closure, Context& context) {
+    auto arg_obj_hold = argument_->Execute(closure, context);
+    auto arg = arg_obj_hold.TryAs<runtime::Bool>();
+    if(arg != nullptr) {
+        return runtime::MakeBool(!arg->GetValue());
+    }
+    throw runtime_error("Not(?)"s);;
+}
+
+NewInstance::NewInstance(const runtime::Class& cls,
+                         std::vector<std::unique_ptr<Statement>> args)
+    : class_(cls), args_(std::move(args)) {}
+
+NewInstance::NewInstance(const runtime::Class& cls) : class_(cls) {}
+
+ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
+    auto result = ObjectHolder().Own(runtime::ClassInstance(class_));
+
+    auto new_obj = result.TryAs<runtime::ClassInstance>();
+    static const runtime::Symbol init_sym = runtime::Intern(INIT_METHOD);
+    const runtime::Method* init = class_.GetMethod(init_sym);
+    if (new_obj != nullptr && init != nullptr && init->formal_params.size() == args_.size()) {
+
+        ArgsBuffer args(args_.size());
+        for (size_t i = 0; i < args_.size(); ++i)
+            args[i] = args_[i]->Execute(closure, context);
+
+        new_obj->Call(*init, args, context);
+    }
+
+    return result;
+}
+
+MethodBody::MethodBody(std::unique_ptr<Statement>&& body)
+    : body_(std::move(body)) {}
+
+void MethodBody::CollectSelfFields(std::vector<runtime::Symbol>& fields) const {
+    body_->CollectSelfFields(fields);
+}
+
+ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
+    body_->Execute(closure, context);
+    if(return_pending) {
+        return_pending = false;
+        return std::move(return_value);
+    }
+    return {};
+}
+
+bool VariableValue::Compile(vm::Compiler& compiler) {
+    // Цепочки id1.id2 исполняются через обходчик
+    if(var_name_ == runtime::kNoSymbol)
+        return false;
+    compiler.EmitLoadVar(var_name_);
+    return true;
+}
+
+bool Assignment::Compile(vm::Compiler& compiler) {
+    compiler.CompileNode(*value_);
+    compiler.EmitStoreVar(name_);
+    return true;
+}
+
+bool Print::Compile(vm::Compiler& compiler) {
+    for(const auto& arg : args_)
+        compiler.CompileNode(*arg);
+    compiler.Emit(vm::Op::Print, static_cast<int>(args_.size()));
+    return true;
+}
+
+bool BinaryOperation::CompileBinary(vm::Compiler& compiler, vm::Op op) {
+    compiler.CompileNode(*lhs_);
+    compiler.CompileNode(*rhs_);
+    compiler.Emit(op);
+    return true;
+}
+
+bool Add::Compile(vm::Compiler& compiler) {
+    return CompileBinary(compiler, vm::Op::Add);
+}
+
+bool Sub::Compile(vm::Compiler& compiler) {
+    return CompileBinary(compiler, vm::Op::Sub);
+}
+
+bool Mult::Compile(vm::Compiler& compiler) {
+    return CompileBinary(compiler, vm::Op::Mult);
+}
+
+bool Div::Compile(vm::Compiler& compiler) {
+    return CompileBinary(compiler, vm::Op::Div);
+}
+
+bool Or::Compile(vm::Compiler& compiler) {
+    compiler.CompileNode(*lhs_);
+    auto end_jump = compiler.EmitJump(vm::Op::JumpOrTrue);
+    compiler.CompileNode(*rhs_);
+    compiler.Emit(vm::Op::ExpectBool, 1);
+    compiler.PatchJump(end_jump);
+    return true;
+}
+
+bool And::Compile(vm::Compiler& compiler) {
+    compiler.CompileNode(*lhs_);
+    auto end_jump = compiler.EmitJump(vm::Op::JumpAndFalse);
+    compiler.CompileNode(*rhs_);
+    compiler.Emit(vm::Op::ExpectBool, 0);
+    compiler.PatchJump(end_jump);
+    return true;
+}
+
+bool Not::Compile(vm::Compiler& compiler) {
+    compiler.CompileNode(*argument_);
+    compiler.Emit(vm::Op::Not);
+    return true;
+}
+
+bool Compound::Compile(vm::Compiler& compiler) {
+    for(const auto& stmt : stmts_)
+        compiler.CompileStatement(*stmt);
+    compiler.EmitConst(ObjectHolder::None());
+    return true;
+}
+
+bool IfElse::Compile(vm::Compiler& compiler) {
+    compiler.CompileNode(*condition_);
+    auto else_jump = compiler.EmitJump(vm::Op::JumpIfFalse);
+    compiler.CompileNode(*if_body_);
+    auto end_jump = compiler.EmitJump(vm::Op::Jump);
+    compiler.PatchJump(else_jump);
+    if(else_body_ != nullptr)
+        compiler.CompileNode(*else_body_);
+    else
+        compiler.EmitConst(ObjectHolder::None());
+    compiler.PatchJump(end_jump);
+    return true;
+}
+
+bool While::Compile(vm::Compiler& compiler) {
+    const auto loop_start = compiler.CodePosition();
+    compiler.CompileNode(*condition_);
+    auto exit_jump = compiler.EmitJump(vm::Op::JumpIfFalse);
+    compiler.CompileStatement(*body_);
+    compiler.Emit(vm::Op::Jump, static_cast<std::int32_t>(loop_start));
+    compiler.PatchJump(exit_jump);
+    compiler.EmitConst(ObjectHolder::None());
+    return true;
+}
+
+void Optimize(std::unique_ptr<Statement>& node) {
+    if(node == nullptr) return;
+    node->FoldChildren();
+    if(auto folded = node->Fold(); folded != nullptr)
+        node = std::move(folded);
+}
+
+void Assignment::FoldChildren() {
+    Optimize(value_);
+}
+
+void FieldAssignment::FoldChildren() {
+    Optimize(value_);
+}
+
+void Print::FoldChildren() {
+    for(auto& arg : args_)
+        Optimize(arg);
+}
+
+void MethodCall::FoldChildren() {
+    Optimize(object_);
+    for(auto& arg : args_)
+        Optimize(arg);
+}
+
+void NewInstance::FoldChildren() {
+    for(auto& arg : args_)
+        Optimize(arg);
+}
+
+void UnaryOperation::FoldChildren() {
+    Optimize(argument_);
+}
+
+void BinaryOperation::FoldChildren() {
+    Optimize(lhs_);
+    Optimize(rhs_);
+}
+
+void Compound::FoldChildren() {
+    for(auto& stmt : stmts_)
+        Optimize(stmt);
+}
+
+void MethodBody::FoldChildren() {
+    Optimize(body_);
+}
+
+void Return::FoldChildren() {
+    Optimize(statement_);
+}
+
+void IfElse::FoldChildren() {
+    Optimize(condition_);
+    Optimize(if_body_);
+    Optimize(else_body_);
+}
+
+void While::FoldChildren() {
+    Optimize(condition_);
+    Optimize(body_);
+}
+
+void ForRange::FoldChildren() {
+    Optimize(from_);
+    Optimize(to_);
+    Optimize(body_);
+}
+
+void Program::FoldChildren() {
+    Optimize(body_);
+}
+
+std::unique_ptr<Statement> Add::Fold() {
+    if(auto lhs = dynamic_cast<NumericConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<NumericConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<NumericConst>(lhs->Value().GetValue() + rhs->Value().GetValue());
+    if(auto lhs = dynamic_cast<StringConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<StringConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<StringConst>(lhs->Value().GetValue() + rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> Sub::Fold() {
+    if(auto lhs = dynamic_cast<NumericConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<NumericConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<NumericConst>(lhs->Value().GetValue() - rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> Mult::Fold() {
+    if(auto lhs = dynamic_cast<NumericConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<NumericConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<NumericConst>(lhs->Value().GetValue() * rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> Div::Fold() {
+    // Деление на ноль не сворачивается: исключение должно быть выброшено
+    // во время выполнения, а не на этапе разбора
+    if(auto lhs = dynamic_cast<NumericConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<NumericConst*>(rhs_.get());
+           rhs != nullptr && rhs->Value().GetValue() != 0)
+            return make_unique<NumericConst>(lhs->Value().GetValue() / rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> Or::Fold() {
+    // Сворачиваются только два константных аргумента: при одном константном
+    // lhs пропал бы побочный эффект вычисления rhs
+    if(auto lhs = dynamic_cast<BoolConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<BoolConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<BoolConst>(lhs->Value().GetValue() || rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> And::Fold() {
+    if(auto lhs = dynamic_cast<BoolConst*>(lhs_.get()); lhs != nullptr)
+        if(auto rhs = dynamic_cast<BoolConst*>(rhs_.get()); rhs != nullptr)
+            return make_unique<BoolConst>(lhs->Value().GetValue() && rhs->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> Not::Fold() {
+    if(auto arg = dynamic_cast<BoolConst*>(argument_.get()); arg != nullptr)
+        return make_unique<BoolConst>(!arg->Value().GetValue());
+    return nullptr;
+}
+
+std::unique_ptr<Statement> IfElse::Fold() {
+    auto cond = dynamic_cast<BoolConst*>(condition_.get());
+    if(cond == nullptr) return nullptr;
+    if(cond->Value().GetValue()) return std::move(if_body_);
+    if(else_body_ != nullptr) return std::move(else_body_);
+    return make_unique<Compound>();
+}
+
+Program::Program(std::unique_ptr<runtime::Arena> arena, std::unique_ptr<Statement> body)
+    : arena_(std::move(arena)), body_(std::move(body)) {
+}
+
+ObjectHolder Program::Execute(Closure& closure, Context& context) {
+    // Признак return, переживший прошлое прерванное исполнение,
+    // не должен оборвать эту программу
+    ResetPendingReturn();
+    auto result = body_->Execute(closure, context);
+    // return вне метода: парсер такое отвергает, но дерево может быть
+    // построено вручную. Признак сбрасывается, чтобы не отравить
+    // следующий запуск в этом потоке
+    if(return_pending) {
+        return_pending = false;
+        throw runtime_error("return"s);
+    }
+    return result;
+}
+
+bool Program::Compile(vm::Compiler& compiler) {
+    return body_->Compile(compiler);
+}
+
+namespace {
+
+// Теги узлов в двоичной записи; значения повторяют имена классов инструкций.
+// Имена переменных, полей и методов записываются строками и интернируются
+// заново при загрузке - значения Symbol не переживают границу процесса
+enum class NodeTag : uint8_t {
+    Number,
+    Bool,
+    String,
+    Variable,
+    Assignment,
+    FieldAssignment,
+    None,
+    Print,
+    MethodCall,
+    NewInstance,
+    Stringify,
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Or,
+    And,
+    Not,
+    Comparison,
+    Compound,
+    MethodBody,
+    Return,
+    ClassDefinition,
+    IfElse,
+    While,
+    ForRange,
+};
+
+// Функции сравнения нумеруются по этой таблице - в том же порядке,
+// что и в таблице функций сравнения файла Chunk
+constexpr vm::Comparator kComparators[] = {
+    runtime::Equal,       runtime::NotEqual, runtime::Less,
+    runtime::LessOrEqual, runtime::Greater,  runtime::GreaterOrEqual,
+};
+
+template <typename T>
+void WriteRaw(ostream& out, T value) {
+    static_assert(is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteString(ostream& out, const string& text) {
+    WriteRaw(out, static_cast<uint32_t>(text.size()));
+    out.write(text.data(), static_cast<streamsize>(text.size()));
+}
+
+void WriteTag(ostream& out, NodeTag tag) {
+    WriteRaw(out, static_cast<uint8_t>(tag));
+}
+
+void WriteName(ostream& out, runtime::Symbol name) {
+    WriteString(out, runtime::SymbolName(name));
+}
+
+template <typename T>
+bool ReadRaw(istream& in, T& value) {
+    static_assert(is_trivially_copyable_v<T>);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool ReadString(istream& in, string& text) {
+    uint32_t size = 0;
+    if(!ReadRaw(in, size)) return false;
+    text.resize(size);
+    return static_cast<bool>(in.read(text.data(), static_cast<streamsize>(size)));
+}
+
+}  // namespace
+
+template <>
+bool ValueStatement<runtime::Number>::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Number);
+    WriteRaw(out, value_.GetValue());
+    return static_cast<bool>(out);
+}
+
+template <>
+bool ValueStatement<runtime::Bool>::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Bool);
+    WriteRaw(out, static_cast<uint8_t>(value_.GetValue()));
+    return static_cast<bool>(out);
+}
+
+template <>
+bool ValueStatement<runtime::String>::Save(ostream& out) const {
+    WriteTag(out, NodeTag::String);
+    WriteString(out, value_.GetValue());
+    return static_cast<bool>(out);
+}
+
+bool VariableValue::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Variable);
+    if(var_name_ != runtime::kNoSymbol) {
+        WriteRaw(out, static_cast<uint32_t>(1));
+        WriteName(out, var_name_);
+    } else {
+        WriteRaw(out, static_cast<uint32_t>(dotted_ids_.size()));
+        for(auto id : dotted_ids_)
+            WriteName(out, id);
+    }
+    return static_cast<bool>(out);
+}
+
+bool Assignment::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Assignment);
+    WriteName(out, name_);
+    return value_->Save(out);
+}
+
+bool FieldAssignment::Save(ostream& out) const {
+    WriteTag(out, NodeTag::FieldAssignment);
+    if(!object_.Save(out)) return false;
+    WriteName(out, name_);
+    return value_->Save(out);
+}
+
+bool None::Save(ostream& out) const {
+    WriteTag(out, NodeTag::None);
+    return static_cast<bool>(out);
+}
+
+bool Print::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Print);
+    WriteRaw(out, static_cast<uint32_t>(args_.size()));
+    for(const auto& arg : args_)
+        if(!arg->Save(out)) return false;
+    return static_cast<bool>(out);
+}
+
+bool MethodCall::Save(ostream& out) const {
+    WriteTag(out, NodeTag::MethodCall);
+    if(!object_->Save(out)) return false;
+    WriteName(out, method_);
+    WriteRaw(out, static_cast<uint32_t>(args_.size()));
+    for(const auto& arg : args_)
+        if(!arg->Save(out)) return false;
+    return static_cast<bool>(out);
+}
+
+bool NewInstance::Save(ostream& out) const {
+    // Класс записывается по имени; загрузчик находит его среди уже
+    // загруженных определений классов и нативных классов
+    WriteTag(out, NodeTag::NewInstance);
+    WriteString(out, class_.GetName());
+    WriteRaw(out, static_cast<uint32_t>(args_.size()));
+    for(const auto& arg : args_)
+        if(!arg->Save(out)) return false;
+    return static_cast<bool>(out);
+}
+
+bool Stringify::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Stringify);
+    return argument_->Save(out);
+}
+
+bool Add::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Add);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool Sub::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Sub);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool Mult::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Mult);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool Div::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Div);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool Or::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Or);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool And::Save(ostream& out) const {
+    WriteTag(out, NodeTag::And);
+    return lhs_->Save(out) && rhs_->Save(out);
+}
+
+bool Not::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Not);
+    return argument_->Save(out);
+}
+
+bool SaveComparisonNode(vm::Comparator cmp, const Statement& lhs, const Statement& rhs,
+                        ostream& out) {
+    auto it = find(begin(kComparators), end(kComparators), cmp);
+    if(it == end(kComparators)) return false;
+    WriteTag(out, NodeTag::Comparison);
+    WriteRaw(out, static_cast<uint8_t>(it - begin(kComparators)));
+    return lhs.Save(out) && rhs.Save(out);
+}
+
+bool Compound::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Compound);
+    WriteRaw(out, static_cast<uint32_t>(stmts_.size()));
+    for(const auto& stmt : stmts_)
+        if(!stmt->Save(out)) return false;
+    return static_cast<bool>(out);
+}
+
+bool MethodBody::Save(ostream& out) const {
+    WriteTag(out, NodeTag::MethodBody);
+    return body_->Save(out);
+}
+
+bool Return::Save(ostream& out) const {
+    WriteTag(out, NodeTag::Return);
+    return statement_->Save(out);
+}
+
+bool ClassDefinition::Save(ostream& out) const {
+    const auto* cls = cls_.TryAs<runtime::Class>();
+    if(cls == nullptr) return false;
+
+    WriteTag(out, NodeTag::ClassDefinition);
+    WriteString(out, cls->GetName());
+    WriteString(out, cls->GetParent() != nullptr ? cls->GetParent()->GetName() : ""s);
+
+    const auto& methods = cls->GetMethods();
+    WriteRaw(out, static_cast<uint32_t>(methods.size()));
+    for(const auto& method : methods) {
+        // Нативная реализация - указатель на функцию этого процесса,
+        // двоичного представления у неё нет
+        if(method.native != nullptr) return false;
+        WriteString(out, method.name);
+        WriteRaw(out, static_cast<uint32_t>(method.formal_params.size()));
+        for(const auto& param : method.formal_params)
+            WriteString(out, param);
+        if(!method.body->Save(out)) return false;
+    }
+    return static_cast<bool>(out);
+}
+
+bool IfElse::Save(ostream& out) const {
+    WriteTag(out, NodeTag::IfElse);
+    if(!condition_->Save(out) || !if_body_->Save(out)) return false;
+    WriteRaw(out, static_cast<uint8_t>(else_body_ != nullptr));
+    if(else_body_ != nullptr) return else_body_->Save(out);
+    return static_cast<bool>(out);
+}
+
+bool While::Save(ostream& out) const {
+    WriteTag(out, NodeTag::While);
+    return condition_->Save(out) && body_->Save(out);
+}
+
+bool ForRange::Save(ostream& out) const {
+    WriteTag(out, NodeTag::ForRange);
+    WriteName(out, var_);
+    WriteRaw(out, static_cast<uint8_t>(from_ != nullptr));
+    if(from_ != nullptr && !from_->Save(out)) return false;
+    return to_->Save(out) && body_->Save(out);
+}
+
+StatementLoader::StatementLoader() {
+    // Нативные классы видны загруженным узлам наравне с классами из файла -
+    // так же заполняет свою таблицу Parser
+    for(const runtime::Class* cls : runtime::NativeClasses())
+        declared_classes_[cls->GetName()] =
+            ObjectHolder::Share(const_cast<runtime::Class&>(*cls));
+}
+
+unique_ptr<Statement> StatementLoader::LoadStatement(istream& in) {  // NOLINT
+    uint8_t raw_tag = 0;
+    if(!ReadRaw(in, raw_tag) || raw_tag > static_cast<uint8_t>(NodeTag::ForRange))
+        return nullptr;
+
+    switch(static_cast<NodeTag>(raw_tag)) {
+    case NodeTag::Number: {
+        int value = 0;
+        if(!ReadRaw(in, value)) return nullptr;
+        return make_unique<NumericConst>(value);
+    }
+    case NodeTag::Bool: {
+        uint8_t value = 0;
+        if(!ReadRaw(in, value)) return nullptr;
+        return make_unique<BoolConst>(value != 0);
+    }
+    case NodeTag::String: {
+        string value;
+        if(!ReadString(in, value)) return nullptr;
+        return make_unique<StringConst>(std::move(value));
+    }
+    case NodeTag::Variable: {
+        uint32_t count = 0;
+        if(!ReadRaw(in, count) || count == 0) return nullptr;
+        vector<string> ids(count);
+        for(auto& id : ids)
+            if(!ReadString(in, id)) return nullptr;
+        if(ids.size() == 1)
+            return make_unique<VariableValue>(ids.front());
+        return make_unique<VariableValue>(std::move(ids));
+    }
+    case NodeTag::Assignment: {
+        string name;
+        if(!ReadString(in, name)) return nullptr;
+        auto value = LoadStatement(in);
+        if(value == nullptr) return nullptr;
+        return make_unique<Assignment>(std::move(name), std::move(value));
+    }
+    case NodeTag::FieldAssignment: {
+        auto object = LoadStatement(in);
+        auto* variable = dynamic_cast<VariableValue*>(object.get());
+        string name;
+        if(variable == nullptr || !ReadString(in, name)) return nullptr;
+        auto value = LoadStatement(in);
+        if(value == nullptr) return nullptr;
+        return make_unique<FieldAssignment>(std::move(*variable), std::move(name),
+                                            std::move(value));
+    }
+    case NodeTag::None:
+        return make_unique<ast::None>();
+    case NodeTag::Print: {
+        uint32_t count = 0;
+        if(!ReadRaw(in, count)) return nullptr;
+        vector<unique_ptr<Statement>> args;
+        args.reserve(count);
+        for(uint32_t i = 0; i < count; ++i) {
+            auto arg = LoadStatement(in);
+            if(arg == nullptr) return nullptr;
+            args.push_back(std::move(arg));
+        }
+        return make_unique<Print>(std::move(args));
+    }
+    case NodeTag::MethodCall: {
+        auto object = LoadStatement(in);
+        string name;
+        uint32_t count = 0;
+        if(object == nullptr || !ReadString(in, name) || !ReadRaw(in, count)) return nullptr;
+        vector<unique_ptr<Statement>> args;
+        args.reserve(count);
+        for(uint32_t i = 0; i < count; ++i) {
+            auto arg = LoadStatement(in);
+            if(arg == nullptr) return nullptr;
+            args.push_back(std::move(arg));
+        }
+        return make_unique<MethodCall>(std::move(object), std::move(name), std::move(args));
+    }
+    case NodeTag::NewInstance: {
+        string name;
+        uint32_t count = 0;
+        if(!ReadString(in, name) || !ReadRaw(in, count)) return nullptr;
+        auto it = declared_classes_.find(name);
+        if(it == declared_classes_.end()) return nullptr;
+        const auto* cls = it->second.TryAs<runtime::Class>();
+        if(cls == nullptr) return nullptr;
+        vector<unique_ptr<Statement>> args;
+        args.reserve(count);
+        for(uint32_t i = 0; i < count; ++i) {
+            auto arg = LoadStatement(in);
+            if(arg == nullptr) return nullptr;
+            args.push_back(std::move(arg));
+        }
+        return make_unique<NewInstance>(*cls, std::move(args));
+    }
+    case NodeTag::Stringify: {
+        auto argument = LoadStatement(in);
+        if(argument == nullptr) return nullptr;
+        return make_unique<Stringify>(std::move(argument));
+    }
+    case NodeTag::Add:
+    case NodeTag::Sub:
+    case NodeTag::Mult:
+    case NodeTag::Div:
+    case NodeTag::Or:
+    case NodeTag::And: {
+        auto lhs = LoadStatement(in);
+        auto rhs = lhs != nullptr ? LoadStatement(in) : nullptr;
+        if(rhs == nullptr) return nullptr;
+        switch(static_cast<NodeTag>(raw_tag)) {
+        case NodeTag::Add:
+            return make_unique<Add>(std::move(lhs), std::move(rhs));
+        case NodeTag::Sub:
+            return make_unique<Sub>(std::move(lhs), std::move(rhs));
+        case NodeTag::Mult:
+            return make_unique<Mult>(std::move(lhs), std::move(rhs));
+        case NodeTag::Div:
+            return make_unique<Div>(std::move(lhs), std::move(rhs));
+        case NodeTag::Or:
+            return make_unique<Or>(std::move(lhs), std::move(rhs));
+        default:
+            return make_unique<And>(std::move(lhs), std::move(rhs));
+        }
+    }
+    case NodeTag::Not: {
+        auto argument = LoadStatement(in);
+        if(argument == nullptr) return nullptr;
+        return make_unique<Not>(std::move(argument));
+    }
+    case NodeTag::Comparison: {
+        uint8_t index = 0;
+        if(!ReadRaw(in, index) || index >= size(kComparators)) return nullptr;
+        auto lhs = LoadStatement(in);
+        auto rhs = lhs != nullptr ? LoadStatement(in) : nullptr;
+        if(rhs == nullptr) return nullptr;
+        switch(index) {
+        case 0:
+            return make_unique<Comparison<runtime::Equal>>(std::move(lhs), std::move(rhs));
+        case 1:
+            return make_unique<Comparison<runtime::NotEqual>>(std::move(lhs), std::move(rhs));
+        case 2:
+            return make_unique<Comparison<runtime::Less>>(std::move(lhs), std::move(rhs));
+        case 3:
+            return make_unique<Comparison<runtime::LessOrEqual>>(std::move(lhs), std::move(rhs));
+        case 4:
+            return make_unique<Comparison<runtime::Greater>>(std::move(lhs), std::move(rhs));
+        default:
+            return make_unique<Comparison<runtime::GreaterOrEqual>>(std::move(lhs),
+                                                                    std::move(rhs));
+        }
+    }
+    case NodeTag::Compound: {
+        uint32_t count = 0;
+        if(!ReadRaw(in, count)) return nullptr;
+        auto result = make_unique<Compound>();
+        for(uint32_t i = 0; i < count; ++i) {
+            auto stmt = LoadStatement(in);
+            if(stmt == nullptr) return nullptr;
+            result->AddStatement(std::move(stmt));
+        }
+        return result;
+    }
+    case NodeTag::MethodBody: {
+        auto body = LoadStatement(in);
+        if(body == nullptr) return nullptr;
+        return make_unique<MethodBody>(std::move(body));
+    }
+    case NodeTag::Return: {
+        auto statement = LoadStatement(in);
+        if(statement == nullptr) return nullptr;
+        return make_unique<Return>(std::move(statement));
+    }
+    case NodeTag::ClassDefinition: {
+        string name;
+        string parent_name;
+        if(!ReadString(in, name) || !ReadString(in, parent_name)) return nullptr;
+
+        const runtime::Class* parent = nullptr;
+        if(!parent_name.empty()) {
+            auto parent_it = declared_classes_.find(parent_name);
+            if(parent_it == declared_classes_.end()) return nullptr;
+            parent = parent_it->second.TryAs<runtime::Class>();
+            if(parent == nullptr) return nullptr;
+        }
+
+        uint32_t method_count = 0;
+        if(!ReadRaw(in, method_count)) return nullptr;
+        vector<runtime::Method> methods;
+        methods.reserve(method_count);
+        for(uint32_t i = 0; i < method_count; ++i) {
+            runtime::Method method;
+            uint32_t param_count = 0;
+            if(!ReadString(in, method.name) || !ReadRaw(in, param_count)) return nullptr;
+            method.formal_params.resize(param_count);
+            for(auto& param : method.formal_params)
+                if(!ReadString(in, param)) return nullptr;
+            method.body = LoadStatement(in);
+            if(method.body == nullptr) return nullptr;
+            methods.push_back(std::move(method));
+        }
+
+        // Класс регистрируется как при разборе исходного текста: следующие
+        // узлы NewInstance и определения наследников находят его по имени
+        auto [it, inserted] = declared_classes_.insert({
+            name,
+            ObjectHolder::Own(runtime::Class(name, std::move(methods), parent)),
+        });
+        if(!inserted) return nullptr;
+        return make_unique<ClassDefinition>(it->second);
+    }
+    case NodeTag::IfElse: {
+        auto condition = LoadStatement(in);
+        auto if_body = condition != nullptr ? LoadStatement(in) : nullptr;
+        uint8_t has_else = 0;
+        if(if_body == nullptr || !ReadRaw(in, has_else)) return nullptr;
+        unique_ptr<Statement> else_body;
+        if(has_else != 0) {
+            else_body = LoadStatement(in);
+            if(else_body == nullptr) return nullptr;
+        }
+        return make_unique<IfElse>(std::move(condition), std::move(if_body),
+                                   std::move(else_body));
+    }
+    case NodeTag::While: {
+        auto condition = LoadStatement(in);
+        auto body = condition != nullptr ? LoadStatement(in) : nullptr;
+        if(body == nullptr) return nullptr;
+        return make_unique<While>(std::move(condition), std::move(body));
+    }
+    case NodeTag::ForRange: {
+        string var_name;
+        uint8_t has_from = 0;
+        if(!ReadString(in, var_name) || !ReadRaw(in, has_from)) return nullptr;
+        unique_ptr<Statement> from;
+        if(has_from != 0) {
+            from = LoadStatement(in);
+            if(from == nullptr) return nullptr;
+        }
+        auto to = LoadStatement(in);
+        auto body = to != nullptr ? LoadStatement(in) : nullptr;
+        if(body == nullptr) return nullptr;
+        return make_unique<ForRange>(std::move(var_name), std::move(from), std::move(to),
+                                     std::move(body));
+    }
+    }
+    return nullptr;
+}
+
+}  // namespace ast
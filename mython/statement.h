@@ -1,349 +1,588 @@
-#pragma once
-
-#include "runtime.h"
-
-#include <functional>
-
-namespace ast {
-
-using Statement = runtime::Executable;
-
-// Выражение, возвращающее значение типа T,
-// используется как основа для создания констант
-template <typename T>
-class ValueStatement : public Statement {
-public:
-    explicit ValueStatement(T v)
-        : value_(std::move(v)) {
-    }
-
-    runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
-                                  runtime::Context& /*context*/) override {
-        return runtime::ObjectHolder::Share(value_);
-    }
-
-private:
-    T value_;
-};
-
-using NumericConst = ValueStatement<runtime::Number>;
-using StringConst = ValueStatement<runtime::String>;
-using BoolConst = ValueStatement<runtime::Bool>;
-
-/*
-Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
-Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
-x = circle.center.x
-*/
-class VariableValue : public Statement {
-public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
-
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::string var_name_{""s};
-    std::vector<std::string> dotted_ids_{};
-};
-
-// Присваивает переменной, имя которой задано в параметре var, значение выражения rv
-class Assignment : public Statement {
-public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
-
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::string name_{""s};
-    std::unique_ptr<Statement> value_ = nullptr;
-};
-
-// Присваивает полю object.field_name значение выражения rv
-class FieldAssignment : public Statement {
-public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
-
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    VariableValue object_;
-    std::string name_{""s};
-    std::unique_ptr<Statement> value_ = nullptr;
-};
-
-// Значение None
-class None : public Statement {
-public:
-    runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
-                                  [[maybe_unused]] runtime::Context& context) override {
-        return {};
-    }
-};
-
-// Команда print
-class Print : public Statement {
-public:
-    // Инициализирует команду print для вывода значения выражения argument
-    explicit Print(std::unique_ptr<Statement> argument);
-    // Инициализирует команду print для вывода списка значений args
-    explicit Print(std::vector<std::unique_ptr<Statement>> args);
-
-    // Инициализирует команду print для вывода значения переменной name
-    static std::unique_ptr<Print> Variable(const std::string& name);
-
-    // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
-    // context.GetOutputStream()
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::vector<std::unique_ptr<Statement>> args_;
-};
-
-// Вызывает метод object.method со списком параметров args
-class MethodCall : public Statement {
-public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
-               std::vector<std::unique_ptr<Statement>> args);
-
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::unique_ptr<Statement> object_;
-    std::string method_;
-    std::vector<std::unique_ptr<Statement>> args_;
-};
-
-/*
-Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
-Если в классе отсутствует метод __init__ с заданным количеством аргументов,
-то экземпляр класса создаётся без вызова конструктора (поля объекта не будут проинициализированы):
-
-class Person:
-  def set_name(name):
-    self.name = name
-
-p = Person()
-# Поле name будет иметь значение только после вызова метода set_name
-p.set_name("Ivan")
-*/
-class NewInstance : public Statement {
-public:
-    explicit NewInstance(const runtime::Class& class_);
-    NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
-    // Возвращает объект, содержащий значение типа ClassInstance
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    const runtime::Class& class_;
-    std::vector<std::unique_ptr<Statement>> args_;
-};
-
-// Базовый класс для унарных операций
-class UnaryOperation : public Statement {
-public:
-    explicit UnaryOperation(std::unique_ptr<Statement> argument)
-        : argument_(std::move(argument)) {}
-
-protected:
-    std::unique_ptr<Statement> argument_;
-};
-
-// Операция str, возвращающая строковое значение своего аргумента
-class Stringify : public UnaryOperation {
-public:
-    using UnaryOperation::UnaryOperation;
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Родительский класс Бинарная операция с аргументами lhs и rhs
-class BinaryOperation : public Statement {
-public:
-    BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs)
-        : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
-
-protected:
-    std::unique_ptr<Statement> lhs_;
-    std::unique_ptr<Statement> rhs_;
-};
-
-// Возвращает результат операции + над аргументами lhs и rhs
-class Add : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-
-    // Поддерживается сложение:
-    //  число + число
-    //  строка + строка
-    //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
-    // В противном случае при вычислении выбрасывается runtime_error
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат вычитания аргументов lhs и rhs
-class Sub : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-
-    // Поддерживается вычитание:
-    //  число - число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат умножения аргументов lhs и rhs
-class Mult : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-
-    // Поддерживается умножение:
-    //  число * число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат деления lhs и rhs
-class Div : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-
-    // Поддерживается деление:
-    //  число / число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
-    // Если rhs равен 0, выбрасывается исключение runtime_error
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат вычисления логической операции or над lhs и rhs
-class Or : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-    // Значение аргумента rhs вычисляется, только если значение lhs
-    // после приведения к Bool равно False
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат вычисления логической операции and над lhs и rhs
-class And : public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-    // Значение аргумента rhs вычисляется, только если значение lhs
-    // после приведения к Bool равно True
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Возвращает результат вычисления логической операции not над единственным аргументом операции
-class Not : public UnaryOperation {
-public:
-    using UnaryOperation::UnaryOperation;
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-};
-
-// Составная инструкция (например: тело метода, содержимое ветки if, либо else)
-class Compound : public Statement {
-public:
-
-    template <typename Arg, typename... Args>
-    void CompoundImpl(Arg&& arg, Args&&... args) {
-        AddStatement(std::forward<Arg>(arg));
-//        if constexpr (sizeof...(args) != 0) {
-//            CompoundImpl(std::forward<Args>(args)...);
-//        }
-        (..., CompoundImpl(std::forward<Args>(args)));
-    }
-
-    // Конструирует Compound из нескольких инструкций типа unique_ptr<Statement>
-    template <typename... Args>
-    explicit Compound(Args&&... args) {
-        if constexpr (sizeof...(args) != 0) {
-            CompoundImpl(std::forward<Args>(args)...);
-        }
-    }
-
-    // Добавляет очередную инструкцию в конец составной инструкции
-    void AddStatement(std::unique_ptr<Statement> stmt) {
-        stmts_.push_back(std::move(stmt));
-    }
-
-    // Последовательно выполняет добавленные инструкции. Возвращает None
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::vector<std::unique_ptr<Statement>> stmts_;
-};
-
-// Тело метода. Как правило, содержит составную инструкцию
-class MethodBody : public Statement {
-public:
-    explicit MethodBody(std::unique_ptr<Statement>&& body);
-
-    // Вычисляет инструкцию, переданную в качестве body.
-    // Если внутри body была выполнена инструкция return, возвращает результат return
-    // В противном случае возвращает None
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::unique_ptr<Statement> body_;
-};
-
-// Выполняет инструкцию return с выражением statement
-class Return : public Statement {
-public:
-    explicit Return(std::unique_ptr<Statement> statement)
-        : statement_(std::move(statement)) {}
-
-    // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
-    // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::unique_ptr<Statement> statement_;
-};
-
-// Объявляет класс
-class ClassDefinition : public Statement {
-public:
-    // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
-    explicit ClassDefinition(runtime::ObjectHolder cls);
-
-    // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
-    // конструктор
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    runtime::ObjectHolder cls_;
-};
-
-// Инструкция if <condition> <if_body> else <else_body>
-class IfElse : public Statement {
-public:
-    // Параметр else_body может быть равен nullptr
-    IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
-           std::unique_ptr<Statement> else_body);
-
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    std::unique_ptr<Statement> condition_;
-    std::unique_ptr<Statement> if_body_;
-    std::unique_ptr<Statement> else_body_;
-};
-
-// Операция сравнения
-class Comparison : public BinaryOperation {
-public:
-    // Comparator задаёт функцию, выполняющую сравнение значений аргументов
-    using Comparator = std::function<bool(const runtime::ObjectHolder&,
-                                          const runtime::ObjectHolder&, runtime::Context&)>;
-
-    Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
-
-    // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
-    // приведённый к типу runtime::Bool
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-private:
-    Comparator cmp_;
-};
-
-}  // namespace ast
+#pragma once
+
+#include "runtime.h"
+#include "vm.h"
+
+namespace ast {
+
+using Statement = runtime::Executable;
+
+// Оптимизирующий проход по дереву: рекурсивно упрощает выражение в node
+// и заменяет node константным узлом, если его значение вычислимо на этапе
+// разбора (константная арифметика, конкатенация строковых литералов,
+// not/and/or над булевыми константами, статически известные ветви if)
+void Optimize(std::unique_ptr<Statement>& node);
+
+// Выражение, возвращающее значение типа T,
+// используется как основа для создания констант
+template <typename T>
+class ValueStatement : public Statement {
+public:
+    explicit ValueStatement(T v)
+        : value_(std::move(v)) {
+    }
+
+    runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
+                                  runtime::Context& /*context*/) override {
+        return runtime::ObjectHolder::Share(value_);
+    }
+
+    bool Compile(vm::Compiler& compiler) override {
+        compiler.EmitConst(runtime::ObjectHolder::Share(value_));
+        return true;
+    }
+
+    bool Save(std::ostream& out) const override;
+
+    // Возвращает хранимое значение-константу
+    [[nodiscard]] const T& Value() const {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+// Числа и логические значения возвращаются значениями-константами:
+// встроенными в держатель либо из пула, без ссылок на само дерево
+template <>
+runtime::ObjectHolder ValueStatement<runtime::Number>::Execute(runtime::Closure& closure,
+                                                               runtime::Context& context);
+template <>
+runtime::ObjectHolder ValueStatement<runtime::Bool>::Execute(runtime::Closure& closure,
+                                                             runtime::Context& context);
+// Строковый литерал разделяется из дерева без владения; в режиме владеющих
+// констант возвращается копия - см. SetOwnedConstants
+template <>
+runtime::ObjectHolder ValueStatement<runtime::String>::Execute(runtime::Closure& closure,
+                                                               runtime::Context& context);
+
+template <>
+bool ValueStatement<runtime::Number>::Save(std::ostream& out) const;
+template <>
+bool ValueStatement<runtime::Bool>::Save(std::ostream& out) const;
+template <>
+bool ValueStatement<runtime::String>::Save(std::ostream& out) const;
+
+/*
+ * Включает в текущем потоке режим владеющих констант: строковые литералы
+ * возвращают владеющую копию значения вместо ссылки на дерево. Нужен
+ * потоковому исполнению, где инструкция освобождается сразу после
+ * исполнения, а её значения могут жить в замыкании дольше
+ */
+void SetOwnedConstants(bool enabled);
+
+// Сбрасывает в текущем потоке признак выполняющегося return - защита от
+// признака, пережившего прерванное исключением исполнение. Вызывается
+// на границе запуска программы
+void ResetPendingReturn();
+
+using NumericConst = ValueStatement<runtime::Number>;
+using StringConst = ValueStatement<runtime::String>;
+using BoolConst = ValueStatement<runtime::Bool>;
+
+/*
+Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
+Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
+x = circle.center.x
+*/
+class VariableValue : public Statement {
+public:
+    explicit VariableValue(const std::string& var_name);
+    explicit VariableValue(std::vector<std::string> dotted_ids);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    bool Save(std::ostream& out) const override;
+
+    // Возвращает true, если выражение - одиночное имя name
+    [[nodiscard]] bool IsName(runtime::Symbol name) const {
+        return var_name_ == name;
+    }
+
+private:
+    runtime::Symbol var_name_ = runtime::kNoSymbol;
+    std::vector<runtime::Symbol> dotted_ids_{};
+    // Кеши шагов доступа к полям цепочки dotted_ids_, по одному на каждый
+    // шаг после первого; FieldCache некопируем, поэтому массив
+    std::unique_ptr<runtime::FieldCache[]> step_caches_;
+};
+
+// Присваивает переменной, имя которой задано в параметре var, значение выражения rv
+class Assignment : public Statement {
+public:
+    Assignment(std::string var, std::unique_ptr<Statement> rv);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    runtime::Symbol name_ = runtime::kNoSymbol;
+    std::unique_ptr<Statement> value_ = nullptr;
+};
+
+// Присваивает полю object.field_name значение выражения rv
+class FieldAssignment : public Statement {
+public:
+    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    VariableValue object_;
+    runtime::Symbol name_ = runtime::kNoSymbol;
+    std::unique_ptr<Statement> value_ = nullptr;
+};
+
+// Значение None
+class None : public Statement {
+public:
+    runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
+                                  [[maybe_unused]] runtime::Context& context) override {
+        return {};
+    }
+
+    bool Compile(vm::Compiler& compiler) override {
+        compiler.EmitConst(runtime::ObjectHolder::None());
+        return true;
+    }
+
+    bool Save(std::ostream& out) const override;
+};
+
+// Команда print
+class Print : public Statement {
+public:
+    // Инициализирует команду print для вывода значения выражения argument
+    explicit Print(std::unique_ptr<Statement> argument);
+    // Инициализирует команду print для вывода списка значений args
+    explicit Print(std::vector<std::unique_ptr<Statement>> args);
+
+    // Инициализирует команду print для вывода значения переменной name
+    static std::unique_ptr<Print> Variable(const std::string& name);
+
+    // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
+    // context.GetOutputStream()
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    // Быстрый путь вывода: значения пишутся в буфер контекста, минуя iostream
+    runtime::ObjectHolder ExecuteBuffered(runtime::OutputBuffer& buffer, runtime::Closure& closure,
+                                          runtime::Context& context);
+
+    std::vector<std::unique_ptr<Statement>> args_;
+};
+
+// Вызывает метод object.method со списком параметров args
+class MethodCall : public Statement {
+public:
+    MethodCall(std::unique_ptr<Statement> object, std::string method,
+               std::vector<std::unique_ptr<Statement>> args);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::unique_ptr<Statement> object_;
+    runtime::Symbol method_ = runtime::kNoSymbol;
+    std::vector<std::unique_ptr<Statement>> args_;
+    // Мономорфный кеш: место вызова почти всегда видит один и тот же класс
+    runtime::MethodCache cache_{};
+};
+
+/*
+Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
+Если в классе отсутствует метод __init__ с заданным количеством аргументов,
+то экземпляр класса создаётся без вызова конструктора (поля объекта не будут проинициализированы):
+
+class Person:
+  def set_name(name):
+    self.name = name
+
+p = Person()
+# Поле name будет иметь значение только после вызова метода set_name
+p.set_name("Ivan")
+*/
+class NewInstance : public Statement {
+public:
+    explicit NewInstance(const runtime::Class& class_);
+    NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
+    // Возвращает объект, содержащий значение типа ClassInstance
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    const runtime::Class& class_;
+    std::vector<std::unique_ptr<Statement>> args_;
+};
+
+// Базовый класс для унарных операций
+class UnaryOperation : public Statement {
+public:
+    explicit UnaryOperation(std::unique_ptr<Statement> argument)
+        : argument_(std::move(argument)) {}
+
+    void FoldChildren() override;
+
+protected:
+    std::unique_ptr<Statement> argument_;
+};
+
+// Операция str, возвращающая строковое значение своего аргумента
+class Stringify : public UnaryOperation {
+public:
+    using UnaryOperation::UnaryOperation;
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Родительский класс Бинарная операция с аргументами lhs и rhs
+class BinaryOperation : public Statement {
+public:
+    BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs)
+        : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+    void FoldChildren() override;
+
+protected:
+    // Пара типов операндов, наблюдавшаяся в предыдущих выполнениях узла.
+    // Позволяет узлу после первого выполнения идти по специализированному
+    // пути (например, число+число), проверяя лишь, что типы не изменились.
+    // Атомарный байт: программа может исполняться несколькими потоками
+    enum class Feedback : std::uint8_t {
+        None,     // узел ещё не выполнялся
+        Number,   // оба операнда были числами
+        String,   // оба операнда были строками
+        Generic,  // другая пара типов либо несработавшая специализация
+    };
+
+    // Компилирует аргументы lhs и rhs и эмитирует инструкцию op над ними
+    bool CompileBinary(vm::Compiler& compiler, vm::Op op);
+
+    // Классифицирует фактическую пару типов операндов
+    static Feedback ObserveTypes(const runtime::ObjectHolder& lhs,
+                                 const runtime::ObjectHolder& rhs);
+
+    std::unique_ptr<Statement> lhs_;
+    std::unique_ptr<Statement> rhs_;
+    std::atomic<Feedback> feedback_{Feedback::None};
+};
+
+// Возвращает результат операции + над аргументами lhs и rhs
+class Add : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    // Поддерживается сложение:
+    //  число + число
+    //  строка + строка
+    //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
+    // В противном случае при вычислении выбрасывается runtime_error
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат вычитания аргументов lhs и rhs
+class Sub : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    // Поддерживается вычитание:
+    //  число - число
+    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат умножения аргументов lhs и rhs
+class Mult : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    // Поддерживается умножение:
+    //  число * число
+    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат деления lhs и rhs
+class Div : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    // Поддерживается деление:
+    //  число / число
+    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    // Если rhs равен 0, выбрасывается исключение runtime_error
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат вычисления логической операции or над lhs и rhs
+class Or : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+    // Значение аргумента rhs вычисляется, только если значение lhs
+    // после приведения к Bool равно False
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат вычисления логической операции and над lhs и rhs
+class And : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+    // Значение аргумента rhs вычисляется, только если значение lhs
+    // после приведения к Bool равно True
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Возвращает результат вычисления логической операции not над единственным аргументом операции
+class Not : public UnaryOperation {
+public:
+    using UnaryOperation::UnaryOperation;
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+};
+
+// Составная инструкция (например: тело метода, содержимое ветки if, либо else)
+class Compound : public Statement {
+public:
+
+    template <typename Arg, typename... Args>
+    void CompoundImpl(Arg&& arg, Args&&... args) {
+        AddStatement(std::forward<Arg>(arg));
+//        if constexpr (sizeof...(args) != 0) {
+//            CompoundImpl(std::forward<Args>(args)...);
+//        }
+        (..., CompoundImpl(std::forward<Args>(args)));
+    }
+
+    // Конструирует Compound из нескольких инструкций типа unique_ptr<Statement>
+    template <typename... Args>
+    explicit Compound(Args&&... args) {
+        if constexpr (sizeof...(args) != 0) {
+            CompoundImpl(std::forward<Args>(args)...);
+        }
+    }
+
+    // Добавляет очередную инструкцию в конец составной инструкции
+    void AddStatement(std::unique_ptr<Statement> stmt) {
+        stmts_.push_back(std::move(stmt));
+    }
+
+    // Последовательно выполняет добавленные инструкции. Возвращает None
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::vector<std::unique_ptr<Statement>> stmts_;
+};
+
+// Тело метода. Как правило, содержит составную инструкцию
+class MethodBody : public Statement {
+public:
+    explicit MethodBody(std::unique_ptr<Statement>&& body);
+
+    // Вычисляет инструкцию, переданную в качестве body.
+    // Если внутри body была выполнена инструкция return, возвращает результат return
+    // В противном случае возвращает None
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::unique_ptr<Statement> body_;
+};
+
+// Выполняет инструкцию return с выражением statement
+class Return : public Statement {
+public:
+    explicit Return(std::unique_ptr<Statement> statement)
+        : statement_(std::move(statement)) {}
+
+    // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
+    // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::unique_ptr<Statement> statement_;
+};
+
+// Объявляет класс
+class ClassDefinition : public Statement {
+public:
+    // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
+    explicit ClassDefinition(runtime::ObjectHolder cls);
+
+    // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
+    // конструктор
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    runtime::ObjectHolder cls_;
+};
+
+// Инструкция if <condition> <if_body> else <else_body>
+class IfElse : public Statement {
+public:
+    // Параметр else_body может быть равен nullptr
+    IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
+           std::unique_ptr<Statement> else_body);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    std::unique_ptr<Statement> Fold() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::unique_ptr<Statement> condition_;
+    std::unique_ptr<Statement> if_body_;
+    std::unique_ptr<Statement> else_body_;
+};
+
+// Цикл while <condition>: <body>. Тело исполняется итеративно в текущем
+// кадре - повторение не требует рекурсивных вызовов методов и не ограничено
+// глубиной нативного стека
+class While : public Statement {
+public:
+    While(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> body);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    std::unique_ptr<Statement> condition_;
+    std::unique_ptr<Statement> body_;
+};
+
+// Цикл for <var> in range(from, to): <body>. Переменная var пробегает числа
+// от from включительно до to невключительно; параметр from может быть равен
+// nullptr - форма range(to) с началом от нуля
+class ForRange : public Statement {
+public:
+    ForRange(std::string var_name, std::unique_ptr<Statement> from, std::unique_ptr<Statement> to,
+             std::unique_ptr<Statement> body);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void CollectSelfFields(std::vector<runtime::Symbol>& fields) const override;
+    void FoldChildren() override;
+    bool Save(std::ostream& out) const override;
+
+private:
+    runtime::Symbol var_;
+    std::unique_ptr<Statement> from_;
+    std::unique_ptr<Statement> to_;
+    std::unique_ptr<Statement> body_;
+};
+
+// Записывает узел сравнения в out от имени шаблона Comparison<Cmp>:
+// формат сериализации определён в statement.cpp, и эта функция выносит
+// его из заголовка
+bool SaveComparisonNode(vm::Comparator cmp, const Statement& lhs, const Statement& rhs,
+                        std::ostream& out);
+
+// Операция сравнения. Функция сравнения Cmp задаётся параметром шаблона,
+// поэтому её вызов в Execute - прямой и встраиваемый, без косвенности
+// через std::function
+template <vm::Comparator Cmp>
+class Comparison : public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    // Вычисляет значение выражений lhs и rhs и возвращает результат Cmp,
+    // приведённый к типу runtime::Bool
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+        auto lhs_obj_hold = lhs_->Execute(closure, context);
+        auto rhs_obj_hold = rhs_->Execute(closure, context);
+        return runtime::MakeBool(Cmp(lhs_obj_hold, rhs_obj_hold, context));
+    }
+
+    bool Compile(vm::Compiler& compiler) override {
+        compiler.CompileNode(*lhs_);
+        compiler.CompileNode(*rhs_);
+        compiler.EmitCompare(Cmp);
+        return true;
+    }
+
+    bool Save(std::ostream& out) const override {
+        return SaveComparisonNode(Cmp, *lhs_, *rhs_, out);
+    }
+};
+
+/*
+ * Корень разобранной программы: хранит дерево инструкций вместе с ареной,
+ * из которой выделены его узлы. Узлы дерева ссылаются на память арены,
+ * поэтому арена разрушается последней - одним махом для всех узлов
+ */
+class Program : public Statement {
+public:
+    Program(std::unique_ptr<runtime::Arena> arena, std::unique_ptr<Statement> body);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool Compile(vm::Compiler& compiler) override;
+    void FoldChildren() override;
+
+private:
+    // Порядок членов существенен: body_ должен быть разрушен раньше arena_
+    std::unique_ptr<runtime::Arena> arena_;
+    std::unique_ptr<Statement> body_;
+};
+
+/*
+ * Восстанавливает узлы инструкций, записанные Statement::Save. Хранит
+ * таблицу объявленных классов - как Parser при разборе исходного текста, -
+ * чтобы последующие узлы NewInstance находили классы по имени. Загрузчик
+ * рассчитан на последовательное чтение узлов одного файла чанка
+ */
+class StatementLoader {
+public:
+    StatementLoader();
+
+    // Читает из in один узел вместе с потомками. Возвращает nullptr,
+    // если данные повреждены или не являются записью Statement::Save
+    std::unique_ptr<Statement> LoadStatement(std::istream& in);
+
+private:
+    runtime::Closure declared_classes_;
+};
+
+}  // namespace ast
@@ -0,0 +1,404 @@
+#include "vm.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+// Сигнатура и версия двоичного формата Chunk
+constexpr char kChunkMagic[4] = {'M', 'Y', 'T', 'C'};
+constexpr uint32_t kChunkVersion = 2;
+
+// Таблица функций сравнения: в файле хранится индекс, а не адрес
+constexpr Comparator kComparators[] = {
+    runtime::Equal,       runtime::NotEqual, runtime::Less,
+    runtime::LessOrEqual, runtime::Greater,  runtime::GreaterOrEqual,
+};
+
+// Теги типов констант в файле
+enum class ConstTag : uint8_t { None, Number, String, Bool };
+
+template <typename T>
+void WriteRaw(ostream& out, T value) {
+    static_assert(is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteString(ostream& out, const string& text) {
+    WriteRaw(out, static_cast<uint32_t>(text.size()));
+    out.write(text.data(), static_cast<streamsize>(text.size()));
+}
+
+template <typename T>
+bool ReadRaw(istream& in, T& value) {
+    static_assert(is_trivially_copyable_v<T>);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool ReadString(istream& in, string& text) {
+    uint32_t size = 0;
+    if(!ReadRaw(in, size)) return false;
+    text.resize(size);
+    return static_cast<bool>(in.read(text.data(), static_cast<streamsize>(size)));
+}
+
+}  // namespace
+
+uint64_t HashSource(string_view source) {
+    // FNV-1a, 64 бита
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned char c : source) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool SaveChunk(const Chunk& chunk, uint64_t source_hash, ostream& out) {
+    // Узлы Op::Exec записываются сначала во временный буфер: если какой-то
+    // из них не сериализуем, функция возвращает false, не записав в out
+    // ни байта
+    ostringstream nodes_buffer;
+    for(const auto* node : chunk.nodes_)
+        if(!node->Save(nodes_buffer)) return false;
+
+    out.write(kChunkMagic, sizeof(kChunkMagic));
+    WriteRaw(out, kChunkVersion);
+    WriteRaw(out, source_hash);
+
+    WriteRaw(out, static_cast<uint32_t>(chunk.code_.size()));
+    for(const auto& [op, arg] : chunk.code_) {
+        WriteRaw(out, static_cast<uint8_t>(op));
+        WriteRaw(out, arg);
+    }
+
+    WriteRaw(out, static_cast<uint32_t>(chunk.constants_.size()));
+    for(const auto& constant : chunk.constants_) {
+        const auto* object = constant.Get();
+        if(object == nullptr) {
+            WriteRaw(out, static_cast<uint8_t>(ConstTag::None));
+            continue;
+        }
+        switch(object->GetType()) {
+        case runtime::Object::Type::Number:
+            WriteRaw(out, static_cast<uint8_t>(ConstTag::Number));
+            WriteRaw(out, static_cast<const runtime::Number&>(*object).GetValue());
+            break;
+        case runtime::Object::Type::String:
+            WriteRaw(out, static_cast<uint8_t>(ConstTag::String));
+            WriteString(out, static_cast<const runtime::String&>(*object).GetValue());
+            break;
+        case runtime::Object::Type::Bool:
+            WriteRaw(out, static_cast<uint8_t>(ConstTag::Bool));
+            WriteRaw(out, static_cast<uint8_t>(
+                              static_cast<const runtime::Bool&>(*object).GetValue()));
+            break;
+        default:
+            throw runtime_error("SaveChunk(? constant)"s);
+        }
+    }
+
+    WriteRaw(out, static_cast<uint32_t>(chunk.names_.size()));
+    for(auto name : chunk.names_)
+        WriteString(out, runtime::SymbolName(name));
+
+    WriteRaw(out, static_cast<uint32_t>(chunk.comparators_.size()));
+    for(auto cmp : chunk.comparators_) {
+        auto it = find(begin(kComparators), end(kComparators), cmp);
+        if(it == end(kComparators))
+            throw runtime_error("SaveChunk(? comparator)"s);
+        WriteRaw(out, static_cast<uint8_t>(it - begin(kComparators)));
+    }
+
+    WriteRaw(out, static_cast<uint32_t>(chunk.nodes_.size()));
+    const string nodes_bytes = nodes_buffer.str();
+    out.write(nodes_bytes.data(), static_cast<streamsize>(nodes_bytes.size()));
+
+    return static_cast<bool>(out);
+}
+
+optional<Chunk> LoadChunk(istream& in, uint64_t expected_source_hash) {
+    char magic[sizeof(kChunkMagic)] = {};
+    if(!in.read(magic, sizeof(magic)) || memcmp(magic, kChunkMagic, sizeof(magic)) != 0)
+        return nullopt;
+
+    uint32_t version = 0;
+    uint64_t source_hash = 0;
+    if(!ReadRaw(in, version) || version != kChunkVersion) return nullopt;
+    if(!ReadRaw(in, source_hash) || source_hash != expected_source_hash) return nullopt;
+
+    Chunk chunk;
+
+    uint32_t code_size = 0;
+    if(!ReadRaw(in, code_size)) return nullopt;
+    chunk.code_.reserve(code_size);
+    for(uint32_t i = 0; i < code_size; ++i) {
+        uint8_t op = 0;
+        int32_t arg = 0;
+        if(!ReadRaw(in, op) || !ReadRaw(in, arg)) return nullopt;
+        if(op > static_cast<uint8_t>(Op::Exec)) return nullopt;
+        chunk.code_.push_back({static_cast<Op>(op), arg});
+    }
+
+    uint32_t const_count = 0;
+    if(!ReadRaw(in, const_count)) return nullopt;
+    chunk.constants_.reserve(const_count);
+    for(uint32_t i = 0; i < const_count; ++i) {
+        uint8_t tag = 0;
+        if(!ReadRaw(in, tag)) return nullopt;
+        switch(static_cast<ConstTag>(tag)) {
+        case ConstTag::None:
+            chunk.constants_.push_back(runtime::ObjectHolder::None());
+            break;
+        case ConstTag::Number: {
+            int value = 0;
+            if(!ReadRaw(in, value)) return nullopt;
+            chunk.constants_.push_back(runtime::MakeNumber(value));
+            break;
+        }
+        case ConstTag::String: {
+            string value;
+            if(!ReadString(in, value)) return nullopt;
+            chunk.constants_.push_back(runtime::ObjectHolder::Own(runtime::String{std::move(value)}));
+            break;
+        }
+        case ConstTag::Bool: {
+            uint8_t value = 0;
+            if(!ReadRaw(in, value)) return nullopt;
+            chunk.constants_.push_back(runtime::MakeBool(value != 0));
+            break;
+        }
+        default:
+            return nullopt;
+        }
+    }
+
+    uint32_t name_count = 0;
+    if(!ReadRaw(in, name_count)) return nullopt;
+    chunk.names_.reserve(name_count);
+    for(uint32_t i = 0; i < name_count; ++i) {
+        string name;
+        if(!ReadString(in, name)) return nullopt;
+        chunk.names_.push_back(runtime::Intern(name));
+    }
+
+    uint32_t cmp_count = 0;
+    if(!ReadRaw(in, cmp_count)) return nullopt;
+    chunk.comparators_.reserve(cmp_count);
+    for(uint32_t i = 0; i < cmp_count; ++i) {
+        uint8_t index = 0;
+        if(!ReadRaw(in, index) || index >= size(kComparators)) return nullopt;
+        chunk.comparators_.push_back(kComparators[index]);
+    }
+
+    uint32_t node_count = 0;
+    if(!ReadRaw(in, node_count)) return nullopt;
+    ast::StatementLoader loader;
+    chunk.nodes_.reserve(node_count);
+    chunk.owned_nodes_.reserve(node_count);
+    for(uint32_t i = 0; i < node_count; ++i) {
+        auto node = loader.LoadStatement(in);
+        if(node == nullptr) return nullopt;
+        chunk.nodes_.push_back(node.get());
+        chunk.owned_nodes_.push_back(std::move(node));
+    }
+
+    return chunk;
+}
+
+Chunk Compiler::Compile(runtime::Executable& program) {
+    chunk_ = Chunk{};
+    CompileNode(program);
+    return std::move(chunk_);
+}
+
+void Compiler::EmitConst(runtime::ObjectHolder value) {
+    chunk_.constants_.push_back(std::move(value));
+    Emit(Op::Const, static_cast<int32_t>(chunk_.constants_.size() - 1));
+}
+
+void Compiler::EmitLoadVar(runtime::Symbol name) {
+    chunk_.names_.push_back(name);
+    Emit(Op::LoadVar, static_cast<int32_t>(chunk_.names_.size() - 1));
+}
+
+void Compiler::EmitStoreVar(runtime::Symbol name) {
+    chunk_.names_.push_back(name);
+    Emit(Op::StoreVar, static_cast<int32_t>(chunk_.names_.size() - 1));
+}
+
+void Compiler::Emit(Op op, int32_t arg) {
+    chunk_.code_.push_back({op, arg});
+}
+
+void Compiler::EmitCompare(Comparator cmp) {
+    chunk_.comparators_.push_back(cmp);
+    Emit(Op::Compare, static_cast<int32_t>(chunk_.comparators_.size() - 1));
+}
+
+void Compiler::EmitExec(runtime::Executable& node) {
+    chunk_.nodes_.push_back(&node);
+    Emit(Op::Exec, static_cast<int32_t>(chunk_.nodes_.size() - 1));
+}
+
+size_t Compiler::CodePosition() const {
+    return chunk_.code_.size();
+}
+
+size_t Compiler::EmitJump(Op op) {
+    Emit(op, -1);
+    return chunk_.code_.size() - 1;
+}
+
+void Compiler::PatchJump(size_t jump_index) {
+    chunk_.code_[jump_index].arg = static_cast<int32_t>(chunk_.code_.size());
+}
+
+void Compiler::CompileNode(runtime::Executable& node) {
+    if(!node.Compile(*this))
+        EmitExec(node);
+}
+
+void Compiler::CompileStatement(runtime::Executable& node) {
+    CompileNode(node);
+    Emit(Op::Pop);
+}
+
+runtime::ObjectHolder VirtualMachine::Run(const Chunk& chunk, runtime::Closure& closure,
+                                          runtime::Context& context) {
+    const auto& code = chunk.code_;
+    const size_t base = stack_.size();
+
+    for(size_t pc = 0; pc < code.size(); ++pc) {
+        const auto& [op, arg] = code[pc];
+        switch (op) {
+        case Op::Const:
+            stack_.push_back(chunk.constants_[arg]);
+            break;
+        case Op::LoadVar: {
+            if(auto it = closure.find(chunk.names_[arg]); it != closure.end()) {
+                stack_.push_back(it->second);
+                break;
+            }
+            throw runtime_error("VariableValue(?)"s);
+        }
+        case Op::StoreVar:
+            closure[chunk.names_[arg]] = stack_.back();
+            break;
+        case Op::Add: {
+            auto rhs = std::move(stack_.back());
+            stack_.pop_back();
+            stack_.back() = runtime::Add(stack_.back(), rhs, context);
+            break;
+        }
+        case Op::Sub: {
+            auto rhs = std::move(stack_.back());
+            stack_.pop_back();
+            stack_.back() = runtime::Sub(stack_.back(), rhs, context);
+            break;
+        }
+        case Op::Mult: {
+            auto rhs = std::move(stack_.back());
+            stack_.pop_back();
+            stack_.back() = runtime::Mult(stack_.back(), rhs, context);
+            break;
+        }
+        case Op::Div: {
+            auto rhs = std::move(stack_.back());
+            stack_.pop_back();
+            stack_.back() = runtime::Div(stack_.back(), rhs, context);
+            break;
+        }
+        case Op::Not: {
+            auto obj = stack_.back().TryAs<runtime::Bool>();
+            if(obj == nullptr)
+                throw runtime_error("Not(?)"s);
+            stack_.back() = runtime::MakeBool(!obj->GetValue());
+            break;
+        }
+        case Op::Compare: {
+            auto rhs = std::move(stack_.back());
+            stack_.pop_back();
+            bool result = chunk.comparators_[arg](stack_.back(), rhs, context);
+            stack_.back() = runtime::MakeBool(result);
+            break;
+        }
+        case Op::Print: {
+            auto& os = context.GetOutputStream();
+            for(size_t i = stack_.size() - arg; i < stack_.size(); ++i) {
+                if(i != stack_.size() - arg) os << " "s;
+
+                if(auto obj = stack_[i].Get(); obj != nullptr)
+                    obj->Print(os, context);
+                else
+                    os << "None"s;
+            }
+            os << "\n"s;
+            stack_.resize(stack_.size() - arg);
+            stack_.push_back(runtime::ObjectHolder::None());
+            break;
+        }
+        case Op::Jump:
+            pc = static_cast<size_t>(arg) - 1;
+            break;
+        case Op::JumpIfFalse: {
+            auto cond = stack_.back().TryAs<runtime::Bool>();
+            if(cond == nullptr)
+                throw runtime_error("IfElse(? condition,,)"s);
+            if(!cond->GetValue())
+                pc = static_cast<size_t>(arg) - 1;
+            stack_.pop_back();
+            break;
+        }
+        case Op::JumpOrTrue: {
+            auto obj = stack_.back().TryAs<runtime::Bool>();
+            if(obj == nullptr)
+                throw runtime_error("Or(?, ?)"s);
+            if(obj->GetValue())
+                pc = static_cast<size_t>(arg) - 1;
+            else
+                stack_.pop_back();
+            break;
+        }
+        case Op::JumpAndFalse: {
+            auto obj = stack_.back().TryAs<runtime::Bool>();
+            if(obj == nullptr)
+                throw runtime_error("And(?, ?)"s);
+            if(!obj->GetValue())
+                pc = static_cast<size_t>(arg) - 1;
+            else
+                stack_.pop_back();
+            break;
+        }
+        case Op::ExpectBool:
+            if(stack_.back().TryAs<runtime::Bool>() == nullptr)
+                throw runtime_error(arg ? "Or(?, ?)"s : "And(?, ?)"s);
+            break;
+        case Op::Pop:
+            stack_.pop_back();
+            break;
+        case Op::Exec:
+            stack_.push_back(chunk.nodes_[arg]->Execute(closure, context));
+            break;
+        }
+    }
+
+    runtime::ObjectHolder result;
+    if(stack_.size() > base) {
+        result = std::move(stack_.back());
+        stack_.resize(base);
+    }
+    return result;
+}
+
+}  // namespace vm
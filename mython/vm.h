@@ -0,0 +1,142 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace vm {
+
+// Коды операций стековой виртуальной машины
+enum class Op : std::uint8_t {
+    Const,          // положить constants[arg] на стек
+    LoadVar,        // положить значение переменной names[arg] из closure
+    StoreVar,       // записать вершину стека в closure[names[arg]], значение остаётся на стеке
+    Add,            // снять два значения, положить их сумму (число/строка/__add__)
+    Sub,            // снять два значения, положить их разность
+    Mult,           // снять два значения, положить их произведение
+    Div,            // снять два значения, положить их частное
+    Not,            // заменить вершину стека (Bool) на противоположное значение
+    Compare,        // применить comparators[arg] к двум верхним значениям, положить Bool
+    Print,          // снять arg значений и вывести их через пробел с переводом строки
+    Jump,           // безусловный переход на код с индексом arg
+    JumpIfFalse,    // снять вершину (Bool), при False перейти на arg
+    JumpOrTrue,     // для or: вершина (Bool) истинна - перейти, оставив значение, иначе снять
+    JumpAndFalse,   // для and: вершина (Bool) ложна - перейти, оставив значение, иначе снять
+    ExpectBool,     // проверить, что вершина - Bool (arg: 0 - and, 1 - or)
+    Pop,            // снять значение со стека
+    Exec,           // выполнить AST-узел nodes[arg] и положить результат
+};
+
+struct Instruction {
+    Op op;
+    std::int32_t arg = 0;
+};
+
+// Функция сравнения двух значений. Обычный указатель на функцию:
+// вызов не требует косвенности и аллокаций std::function
+using Comparator = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                            runtime::Context&);
+
+/*
+ * Скомпилированная программа: плоский массив инструкций и таблицы констант,
+ * имён и функций сравнения. Узлы, для которых нет байткодового представления,
+ * исполняются через Op::Exec. Chunk, скомпилированный из дерева, не владеет
+ * его узлами и должен жить не дольше дерева; Chunk, загруженный из файла,
+ * владеет восстановленными узлами сам.
+ */
+class Chunk {
+public:
+    [[nodiscard]] const std::vector<Instruction>& Code() const {
+        return code_;
+    }
+
+private:
+    friend class Compiler;
+    friend class VirtualMachine;
+    friend bool SaveChunk(const Chunk& chunk, std::uint64_t source_hash, std::ostream& out);
+    friend std::optional<Chunk> LoadChunk(std::istream& in, std::uint64_t expected_source_hash);
+
+    std::vector<Instruction> code_;
+    std::vector<runtime::ObjectHolder> constants_;
+    std::vector<runtime::Symbol> names_;
+    std::vector<Comparator> comparators_;
+    std::vector<runtime::Executable*> nodes_;
+    // Узлы, восстановленные LoadChunk; nodes_ указывает на них
+    std::vector<std::unique_ptr<runtime::Executable>> owned_nodes_;
+};
+
+/*
+ * Компилятор понижает дерево ast::Statement в Chunk. Узлы сотрудничают с ним
+ * через виртуальный метод Executable::Compile: узел либо эмитирует свои
+ * инструкции и возвращает true, либо возвращает false, и тогда компилятор
+ * эмитирует Op::Exec - исполнение узла остаётся за обходчиком дерева.
+ */
+class Compiler {
+public:
+    // Компилирует program, возвращает Chunk. program должен пережить Chunk
+    [[nodiscard]] Chunk Compile(runtime::Executable& program);
+
+    // Интерфейс эмиссии для Executable::Compile
+    void EmitConst(runtime::ObjectHolder value);
+    void EmitLoadVar(runtime::Symbol name);
+    void EmitStoreVar(runtime::Symbol name);
+    void Emit(Op op, std::int32_t arg = 0);
+    void EmitCompare(Comparator cmp);
+    void EmitExec(runtime::Executable& node);
+
+    // Возвращает индекс следующей эмитируемой инструкции - цель обратного перехода
+    [[nodiscard]] std::size_t CodePosition() const;
+    // Эмитирует переход с ещё не известной целью, возвращает индекс инструкции
+    std::size_t EmitJump(Op op);
+    // Устанавливает цель перехода jump_index на текущий конец кода
+    void PatchJump(std::size_t jump_index);
+
+    // Компилирует узел: через node.Compile либо через Op::Exec.
+    // После исполнения узла на стеке остаётся ровно одно значение
+    void CompileNode(runtime::Executable& node);
+    // Компилирует узел в позиции инструкции: результат снимается со стека
+    void CompileStatement(runtime::Executable& node);
+
+private:
+    Chunk chunk_;
+};
+
+// FNV-1a хеш исходного текста программы; применяется для проверки
+// актуальности сериализованного Chunk
+[[nodiscard]] std::uint64_t HashSource(std::string_view source);
+
+/*
+ * Сериализация скомпилированной программы для быстрого старта: разобранный
+ * однажды скрипт сохраняется в двоичном виде и загружается без лексера и
+ * парсера. Вместе с Chunk записывается хеш исходного текста - загрузчик
+ * отказывает при несовпадении, и программа разбирается заново.
+ */
+
+// Записывает chunk в out и возвращает true. Узлы AST, на которые ссылаются
+// инструкции Op::Exec, записываются вместе с потоком инструкций - см.
+// Executable::Save. Возвращает false, не записывая ничего, если какой-либо
+// из узлов не сериализуем
+bool SaveChunk(const Chunk& chunk, std::uint64_t source_hash, std::ostream& out);
+
+// Восстанавливает Chunk из in; восстановленными узлами AST владеет сам
+// Chunk. Возвращает nullopt, если сигнатура или версия формата не совпадают
+// либо хеш исходного текста отличается от ожидаемого
+std::optional<Chunk> LoadChunk(std::istream& in, std::uint64_t expected_source_hash);
+
+// Исполняет скомпилированный Chunk. Стек значений переиспользуется между запусками
+class VirtualMachine {
+public:
+    // Исполняет программу chunk, возвращает значение вершины стека либо None
+    runtime::ObjectHolder Run(const Chunk& chunk, runtime::Closure& closure,
+                              runtime::Context& context);
+
+private:
+    std::vector<runtime::ObjectHolder> stack_;
+};
+
+}  // namespace vm